@@ -28,7 +28,7 @@ GestureEngine<AdpsType> Gestures;
 
 /* for normal hardware wire use above */
 
-constexpr uint32_t GesturePollIntervalMs = 66; // 66ms, 15 times a second 
+constexpr uint32_t GestureIdlePollIntervalMs = 66; // 66ms, 15 times a second while no gesture
 
 // handy routine to return true if there was an error
 // but it will also print out an error message with the given topic
@@ -126,6 +126,10 @@ void setup ()
     Adps.SetGesturePulseConfig();
     wasError("setup SetGesturePulseConfig");
 
+    // let the gesture engine know the timing that was configured above
+    // so it can poll faster only while a gesture is active
+    Gestures.SetGestureTiming();
+
     // Gesture only
     Adps.Start(Feature_Gesture);
     wasError("setup Start");
@@ -169,6 +173,8 @@ void onGesture(GestureVector gesture)
 
 void loop () 
 {
-    Gestures.Poll(Adps, onGesture, GesturePollIntervalMs);
-    wasError("loop Gestures.Poll");
+    Gestures.PollAdaptive(Adps, onGesture, GestureIdlePollIntervalMs);
+    wasError("loop Gestures.PollAdaptive");
+
+    // other work can be done here until Gestures.NextDeadlineMs()
 }
@@ -0,0 +1,317 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+// Host command line tool that prints the ADPS9960 energy model estimates
+// for a configuration, see src/Adps9960_EnergyModel.h
+//
+// build:
+//    g++ -std=c++11 -O2 -I../../src EnergyEstimator.cpp -o EnergyEstimator
+//
+// example:
+//    EnergyEstimator --features pag --wait-ms 100 --gesture-duty 20 --battery-mah 220
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Adps9960_EnergyModel.h"
+
+using namespace ADPS9960;
+
+static void printUsage()
+{
+    printf("usage: EnergyEstimator [options]\n"
+        "  --features [p][a][g]      enabled features (default pa)\n"
+        "  --als-ms <ms>             ALS ADC time (default 27.8)\n"
+        "  --wait-ms <ms>            wait time, long wait used when >= 33.36 (default 2.78)\n"
+        "  --prox-drive <mA>         100, 50, 25 or 12.5 (default 100)\n"
+        "  --prox-boost <percent>    100, 150, 200 or 300, the LED boost is shared\n"
+        "                            with gesture (default 300 with g, else 100)\n"
+        "  --prox-pulses <count>     1-64 (default 8)\n"
+        "  --prox-length <us>        4, 8, 16 or 32 (default 8)\n"
+        "  --gesture-drive <mA>      100, 50, 25 or 12.5 (default 100)\n"
+        "  --gesture-boost <percent> the same shared LED boost, must match --prox-boost\n"
+        "  --gesture-pulses <count>  1-64 (default 8)\n"
+        "  --gesture-length <us>     4, 8, 16 or 32 (default 8)\n"
+        "  --gesture-wait <index>    GestureWaitTime 0-7 (default 1, 2.8ms)\n"
+        "  --gesture-duty <permille> time spent in gesture mode (default 0)\n"
+        "  --supply-mv <mV>          supply voltage (default 3300)\n"
+        "  --battery-mah <mAh>       battery capacity for a life estimate\n");
+}
+
+static uint8_t msToTimeReg(float ms)
+{
+    if (ms > 712.0f)
+    {
+        ms = 712.0f;
+    }
+    if (ms < MS_ADC_TIME_QUOTUM)
+    {
+        ms = MS_ADC_TIME_QUOTUM;
+    }
+    return static_cast<uint8_t>(256.0f - (ms / MS_ADC_TIME_QUOTUM));
+}
+
+static LedDriveCurrent parseDrive(const char* mA)
+{
+    float current = static_cast<float>(atof(mA));
+
+    if (current >= 100.0f)
+    {
+        return LedDriveCurrent_100mA;
+    }
+    else if (current >= 50.0f)
+    {
+        return LedDriveCurrent_50mA;
+    }
+    else if (current >= 25.0f)
+    {
+        return LedDriveCurrent_25mA;
+    }
+    return LedDriveCurrent_12_5mA;
+}
+
+static bool parseBoost(const char* percent, LedDriveCurrent* boost)
+{
+    switch (atoi(percent))
+    {
+    case 100:
+        *boost = LedDriveCurrent_100mA;
+        break;
+    case 150:
+        *boost = LedDriveCurrent_150mA;
+        break;
+    case 200:
+        *boost = LedDriveCurrent_200mA;
+        break;
+    case 300:
+        *boost = LedDriveCurrent_300mA;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+static ProximityPulseLength parseLength(const char* us)
+{
+    switch (atoi(us))
+    {
+    case 4:
+        return ProximityPulseLength_4us;
+    case 16:
+        return ProximityPulseLength_16us;
+    case 32:
+        return ProximityPulseLength_32us;
+    default:
+        return ProximityPulseLength_8us;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    uint8_t features = Feature_Proximity_Als;
+    float alsMs = MS_ALS_ADC_TIME_DEFAULT;
+    float waitMs = MS_ADC_TIME_QUOTUM;
+    const char* proxDrive = "100";
+    const char* proxBoost = NULL;
+    const char* gestureDrive = "100";
+    const char* gestureBoost = NULL;
+    uint8_t proxPulses = 8;
+    ProximityPulseLength proxLength = ProximityPulseLength_Default;
+    uint8_t gesturePulses = 8;
+    ProximityPulseLength gestureLength = ProximityPulseLength_8us;
+    GestureWaitTime gestureWait = GestureWaitTime_Default;
+    uint16_t gestureDuty = 0;
+    uint16_t supplyMv = 3300;
+    float batteryMah = 0.0f;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        const char* option = argv[arg];
+        const char* value = (arg + 1 < argc) ? argv[arg + 1] : NULL;
+
+        if (value == NULL)
+        {
+            printUsage();
+            return 1;
+        }
+        arg++;
+
+        if (strcmp(option, "--features") == 0)
+        {
+            features = Feature_None;
+            if (strchr(value, 'p'))
+            {
+                features |= Feature_Proximity;
+            }
+            if (strchr(value, 'a'))
+            {
+                features |= Feature_AmbiantLightSensor;
+            }
+            if (strchr(value, 'g'))
+            {
+                // proximity must also be enabled
+                features |= Feature_Gesture_Proximity;
+            }
+        }
+        else if (strcmp(option, "--als-ms") == 0)
+        {
+            alsMs = static_cast<float>(atof(value));
+        }
+        else if (strcmp(option, "--wait-ms") == 0)
+        {
+            waitMs = static_cast<float>(atof(value));
+        }
+        else if (strcmp(option, "--prox-drive") == 0)
+        {
+            proxDrive = value;
+        }
+        else if (strcmp(option, "--prox-boost") == 0)
+        {
+            proxBoost = value;
+        }
+        else if (strcmp(option, "--prox-pulses") == 0)
+        {
+            proxPulses = static_cast<uint8_t>(atoi(value));
+        }
+        else if (strcmp(option, "--prox-length") == 0)
+        {
+            proxLength = parseLength(value);
+        }
+        else if (strcmp(option, "--gesture-drive") == 0)
+        {
+            gestureDrive = value;
+        }
+        else if (strcmp(option, "--gesture-boost") == 0)
+        {
+            gestureBoost = value;
+        }
+        else if (strcmp(option, "--gesture-pulses") == 0)
+        {
+            gesturePulses = static_cast<uint8_t>(atoi(value));
+        }
+        else if (strcmp(option, "--gesture-length") == 0)
+        {
+            gestureLength = parseLength(value);
+        }
+        else if (strcmp(option, "--gesture-wait") == 0)
+        {
+            gestureWait = static_cast<GestureWaitTime>(atoi(value) & 0x07);
+        }
+        else if (strcmp(option, "--gesture-duty") == 0)
+        {
+            gestureDuty = static_cast<uint16_t>(atoi(value));
+            if (gestureDuty > 1000)
+            {
+                gestureDuty = 1000;
+            }
+        }
+        else if (strcmp(option, "--supply-mv") == 0)
+        {
+            supplyMv = static_cast<uint16_t>(atoi(value));
+        }
+        else if (strcmp(option, "--battery-mah") == 0)
+        {
+            batteryMah = static_cast<float>(atof(value));
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // one LED boost on the device, SetGestureConfig defaults it to 300%
+    const char* boostPercent = (features & Feature_Gesture) ? "300" : "100";
+    if (proxBoost && gestureBoost && atoi(proxBoost) != atoi(gestureBoost))
+    {
+        fprintf(stderr, "--prox-boost and --gesture-boost conflict, the LED boost is shared\n");
+        return 1;
+    }
+    if (proxBoost)
+    {
+        boostPercent = proxBoost;
+    }
+    else if (gestureBoost)
+    {
+        boostPercent = gestureBoost;
+    }
+
+    LedDriveCurrent ledBoost;
+    if (!parseBoost(boostPercent, &ledBoost))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // same long wait selection as Adps9960::SetWaitTime
+    bool waitLong = (waitMs >= MS_ADC_TIME_QUOTUM * 12.0f);
+    uint8_t wtime = msToTimeReg(waitLong ? waitMs / 12.0f : waitMs);
+
+    EnergyConfig config(static_cast<Feature>(features),
+        msToTimeReg(alsMs),
+        wtime,
+        waitLong,
+        ledBoost,
+        parseDrive(proxDrive),
+        proxPulses,
+        proxLength,
+        parseDrive(gestureDrive),
+        gesturePulses,
+        gestureLength,
+        gestureWait);
+
+    uint32_t cycleUs = EnergyCycleUs(config);
+    uint32_t chargePc = EnergyChargePerCyclePc(config);
+    uint32_t cycleUa = EnergyAverageCurrentUa(config);
+    uint32_t averageUa = EnergyAverageCurrentUa(config, gestureDuty);
+
+    printf("LED boost              : %d %%\n", atoi(boostPercent));
+    printf("proximity/ALS cycle    : %.2f ms (%.1f Hz)\n", cycleUs / 1000.0, 1000000.0 / cycleUs);
+    printf("  average current      : %u uA\n", cycleUa);
+    printf("  energy per sample    : %.3f uJ\n", static_cast<double>(chargePc) * supplyMv / 1e9);
+
+    if (features & Feature_Gesture)
+    {
+        uint32_t gestureUa = EnergyGestureAverageCurrentUa(config);
+
+        printf("gesture cycle          : %.2f ms\n", EnergyGestureCycleUs(config) / 1000.0);
+        printf("  average current      : %u uA\n", gestureUa);
+        printf("  energy per sample    : %.3f uJ\n", EnergyPerGestureSampleNj(config, supplyMv) / 1000.0);
+        printf("gesture duty           : %.1f %%\n", gestureDuty / 10.0);
+    }
+
+    printf("average supply current : %u uA\n", averageUa);
+
+    if (batteryMah > 0.0f && averageUa > 0)
+    {
+        double hours = batteryMah * 1000.0 / averageUa;
+        printf("battery life           : %.0f hours (%.1f days)\n", hours, hours / 24.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,637 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+// Host command line tool that trains a small decision tree gesture
+// classifier from labeled traces and writes it as a header for
+// GestureClassifierDecisionTree, see src/Adps9960_GestureClassifiers.h
+//
+// build:
+//    g++ -std=c++11 -O2 -I../../src GestureTreeTrainer.cpp -o GestureTreeTrainer
+//
+// example:
+//    GestureTreeTrainer --depth 4 --name CoverGlassTree --out CoverGlassTree.h traces.csv
+//
+// Traces are CSV rows of
+//    trace,label,ms,up,down,left,right
+// where trace groups the samples of one gesture, label is Up, Down, Left,
+// Right or Unknown (for rejects like a hand just passing by) and ms is the
+// sample time.  GestureEngine::SetSampleCallback() gives exactly these
+// samples, print them while performing known gestures to capture traces.
+// Lines that don't start with a digit are ignored.
+//
+// The features are computed with the same code the device runs
+// (src/Adps9960_GestureFeatures.h) from the first and last --sample-depth
+// samples, which must match the V_SAMPLE_DEPTH of the GestureEngine.  The
+// generated tree records it as SampleDepth and the engine checks it.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "Adps9960_GestureFeatures.h"
+
+using namespace ADPS9960;
+
+static const char* GestureNames[] = { "Up", "Down", "Left", "Right", "Hold", "Unknown" };
+static const uint8_t GestureNameCount = countof(GestureNames);
+
+static const char* FeatureNames[] =
+{
+    "GestureFeature_EntryMin",
+    "GestureFeature_ExitMin",
+    "GestureFeature_EntryX",
+    "GestureFeature_EntryY",
+    "GestureFeature_ExitX",
+    "GestureFeature_ExitY",
+    "GestureFeature_SlopeX",
+    "GestureFeature_SlopeY",
+    "GestureFeature_DurationMs",
+};
+
+struct TraceSample
+{
+    uint32_t Ms;
+    GestureData Data;
+};
+
+struct Trace
+{
+    long Id;
+    uint8_t Label;
+    std::vector<TraceSample> Samples;
+};
+
+struct Example
+{
+    GestureFeatures Features;
+    uint8_t Label;
+};
+
+struct Options
+{
+    Options() :
+        MaxDepth(4),
+        MinLeaf(2),
+        SampleDepth(4),
+        Name("GestureTree"),
+        OutPath(NULL)
+    {
+    }
+
+    uint8_t MaxDepth;
+    uint16_t MinLeaf;
+    uint8_t SampleDepth;
+    const char* Name;
+    const char* OutPath;
+};
+
+static void printUsage()
+{
+    printf("usage: GestureTreeTrainer [options] [traces.csv ...]\n"
+        "  --depth <levels>        maximum tree depth 1-7 (default 4)\n"
+        "  --min-leaf <count>      minimum traces per leaf (default 2)\n"
+        "  --sample-depth <count>  GestureEngine V_SAMPLE_DEPTH (default 4)\n"
+        "  --name <identifier>     generated tree type name (default GestureTree)\n"
+        "  --out <file>            header to write (default stdout)\n"
+        "traces are read from stdin when no file is given\n");
+}
+
+static bool parseLabel(const char* text, uint8_t* label)
+{
+    for (uint8_t gesture = 0; gesture < GestureNameCount; gesture++)
+    {
+        if (gesture != GestureVector_Hold && strcmp(text, GestureNames[gesture]) == 0)
+        {
+            *label = gesture;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool readTraces(FILE* file, const char* name, std::vector<Trace>& traces)
+{
+    char line[256];
+    unsigned lineNumber = 0;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        lineNumber++;
+        if (line[0] < '0' || line[0] > '9')
+        {
+            continue;
+        }
+
+        long id;
+        char label[16];
+        unsigned long ms;
+        unsigned up;
+        unsigned down;
+        unsigned left;
+        unsigned right;
+        uint8_t gesture;
+
+        if (sscanf(line, "%ld,%15[^,],%lu,%u,%u,%u,%u", &id, label, &ms, &up, &down, &left, &right) != 7 ||
+            !parseLabel(label, &gesture))
+        {
+            fprintf(stderr, "%s:%u: malformed trace row\n", name, lineNumber);
+            return false;
+        }
+
+        if (traces.empty() || traces.back().Id != id)
+        {
+            Trace trace;
+            trace.Id = id;
+            trace.Label = gesture;
+            traces.push_back(trace);
+        }
+
+        TraceSample sample;
+        sample.Ms = static_cast<uint32_t>(ms);
+        sample.Data = GestureData(up, down, left, right);
+        traces.back().Samples.push_back(sample);
+    }
+    return true;
+}
+
+// mirrors the GestureEngine windows, entry is the first samples and
+// exit is the last samples once both windows have been filled
+static bool extractExample(const Trace& trace, uint8_t sampleDepth, Example* example)
+{
+    size_t count = trace.Samples.size();
+    if (count < static_cast<size_t>(sampleDepth) * 2)
+    {
+        return false;
+    }
+
+    CircularQueue<GestureData> window(sampleDepth);
+
+    for (size_t index = 0; index < sampleDepth; index++)
+    {
+        window.Enqueue(trace.Samples[index].Data);
+    }
+    example->Features.SetEntry(window);
+
+    window.Clear();
+    for (size_t index = count - sampleDepth; index < count; index++)
+    {
+        window.Enqueue(trace.Samples[index].Data);
+    }
+    example->Features.SetExit(window, trace.Samples[count - 1].Ms - trace.Samples[0].Ms);
+    example->Label = trace.Label;
+    return true;
+}
+
+class TreeBuilder
+{
+public:
+    TreeBuilder(const std::vector<Example>& examples, const Options& options) :
+        _examples(examples),
+        _options(options)
+    {
+    }
+
+    void Build()
+    {
+        std::vector<size_t> all;
+        for (size_t index = 0; index < _examples.size(); index++)
+        {
+            all.push_back(index);
+        }
+        build(all, 0);
+    }
+
+    const std::vector<GestureTreeNode>& Nodes() const
+    {
+        return _nodes;
+    }
+
+private:
+    const std::vector<Example>& _examples;
+    const Options& _options;
+    std::vector<GestureTreeNode> _nodes;
+
+    // weighted gini impurity times count, lower is purer
+    static double impurity(const unsigned* counts, unsigned total)
+    {
+        if (total == 0)
+        {
+            return 0.0;
+        }
+
+        double sumSquares = 0.0;
+        for (uint8_t label = 0; label < GestureNameCount; label++)
+        {
+            sumSquares += static_cast<double>(counts[label]) * counts[label];
+        }
+        return total - sumSquares / total;
+    }
+
+    uint8_t majority(const std::vector<size_t>& subset) const
+    {
+        unsigned counts[GestureNameCount] = {};
+        uint8_t best = GestureVector_Unknown;
+
+        for (size_t index : subset)
+        {
+            counts[_examples[index].Label]++;
+        }
+        for (uint8_t label = 0; label < GestureNameCount; label++)
+        {
+            if (counts[label] > counts[best])
+            {
+                best = label;
+            }
+        }
+        return best;
+    }
+
+    bool findSplit(const std::vector<size_t>& subset, uint8_t* bestFeature, int16_t* bestThreshold) const
+    {
+        unsigned totalCounts[GestureNameCount] = {};
+        for (size_t index : subset)
+        {
+            totalCounts[_examples[index].Label]++;
+        }
+
+        double bestScore = impurity(totalCounts, subset.size());
+        bool found = false;
+
+        for (uint8_t feature = 0; feature < GestureFeature_Count; feature++)
+        {
+            // candidate thresholds are the distinct values, left is <= threshold
+            std::vector<int16_t> values;
+            for (size_t index : subset)
+            {
+                values.push_back(_examples[index].Features[feature]);
+            }
+
+            for (int16_t threshold : values)
+            {
+                unsigned leftCounts[GestureNameCount] = {};
+                unsigned rightCounts[GestureNameCount] = {};
+                unsigned leftTotal = 0;
+
+                for (size_t index : subset)
+                {
+                    const Example& example = _examples[index];
+                    if (example.Features[feature] <= threshold)
+                    {
+                        leftCounts[example.Label]++;
+                        leftTotal++;
+                    }
+                    else
+                    {
+                        rightCounts[example.Label]++;
+                    }
+                }
+
+                unsigned rightTotal = subset.size() - leftTotal;
+                if (leftTotal < _options.MinLeaf || rightTotal < _options.MinLeaf)
+                {
+                    continue;
+                }
+
+                double score = impurity(leftCounts, leftTotal) + impurity(rightCounts, rightTotal);
+                if (score < bestScore - 1e-9)
+                {
+                    bestScore = score;
+                    *bestFeature = feature;
+                    *bestThreshold = threshold;
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+
+    uint8_t addLeaf(uint8_t label)
+    {
+        GestureTreeNode node = { GestureTreeLeaf, 0, label, 0 };
+        _nodes.push_back(node);
+        return static_cast<uint8_t>(_nodes.size() - 1);
+    }
+
+    uint8_t build(const std::vector<size_t>& subset, uint8_t depth)
+    {
+        uint8_t feature = 0;
+        int16_t threshold = 0;
+
+        if (depth >= _options.MaxDepth ||
+            _nodes.size() + 3 > GestureTreeLeaf ||
+            !findSplit(subset, &feature, &threshold))
+        {
+            return addLeaf(majority(subset));
+        }
+
+        std::vector<size_t> left;
+        std::vector<size_t> right;
+        for (size_t index : subset)
+        {
+            if (_examples[index].Features[feature] <= threshold)
+            {
+                left.push_back(index);
+            }
+            else
+            {
+                right.push_back(index);
+            }
+        }
+
+        size_t nodeIndex = _nodes.size();
+        GestureTreeNode node = { feature, threshold, 0, 0 };
+        _nodes.push_back(node);
+
+        uint8_t leftIndex = build(left, depth + 1);
+        uint8_t rightIndex = build(right, depth + 1);
+
+        // a split whose sides agree is no split at all
+        const GestureTreeNode& leftNode = _nodes[leftIndex];
+        const GestureTreeNode& rightNode = _nodes[rightIndex];
+        if (leftNode.Feature == GestureTreeLeaf &&
+            rightNode.Feature == GestureTreeLeaf &&
+            leftNode.Left == rightNode.Left)
+        {
+            uint8_t label = leftNode.Left;
+            _nodes.resize(nodeIndex);
+            return addLeaf(label);
+        }
+
+        _nodes[nodeIndex].Left = leftIndex;
+        _nodes[nodeIndex].Right = rightIndex;
+        return static_cast<uint8_t>(nodeIndex);
+    }
+};
+
+// same walk as GestureClassifierDecisionTree::Classify but on host memory
+static uint8_t classify(const std::vector<GestureTreeNode>& nodes, const GestureFeatures& features)
+{
+    uint8_t index = 0;
+
+    while (nodes[index].Feature != GestureTreeLeaf)
+    {
+        const GestureTreeNode& node = nodes[index];
+        index = (features[node.Feature] <= node.Threshold) ? node.Left : node.Right;
+    }
+    return nodes[index].Left;
+}
+
+static uint8_t treeDepth(const std::vector<GestureTreeNode>& nodes, uint8_t index)
+{
+    const GestureTreeNode& node = nodes[index];
+    if (node.Feature == GestureTreeLeaf)
+    {
+        return 0;
+    }
+
+    uint8_t left = treeDepth(nodes, node.Left);
+    uint8_t right = treeDepth(nodes, node.Right);
+    return 1 + ((left > right) ? left : right);
+}
+
+static void writeHeader(FILE* out,
+    const Options& options,
+    const std::vector<GestureTreeNode>& nodes,
+    size_t exampleCount,
+    unsigned correct)
+{
+    fprintf(out, "// generated by GestureTreeTrainer, do not edit\n"
+        "// %u traces, sample depth %u, training accuracy %u%%\n"
+        "//\n"
+        "// ADPS9960::GestureEngine<Adps9960<TwoWire>, %u, ADPS_UTIL::ClockMillis,\n"
+        "//     ADPS9960::GestureClassifierDecisionTree<%s>> gestureEngine;\n"
+        "//\n\n",
+        static_cast<unsigned>(exampleCount),
+        options.SampleDepth,
+        static_cast<unsigned>(correct * 100 / exampleCount),
+        options.SampleDepth,
+        options.Name);
+
+    fprintf(out, "#pragma once\n\n"
+        "#include \"Adps9960_GestureFeatures.h\"\n\n");
+
+    fprintf(out, "constexpr ADPS9960::GestureTreeNode %sNodes[] PROGMEM =\n{\n", options.Name);
+    for (const GestureTreeNode& node : nodes)
+    {
+        if (node.Feature == GestureTreeLeaf)
+        {
+            fprintf(out, "    { ADPS9960::GestureTreeLeaf, 0, ADPS9960::GestureVector_%s, 0 },\n",
+                GestureNames[node.Left]);
+        }
+        else
+        {
+            fprintf(out, "    { ADPS9960::%s, %d, %u, %u },\n",
+                FeatureNames[node.Feature],
+                node.Threshold,
+                node.Left,
+                node.Right);
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "struct %s\n"
+        "{\n"
+        "    static constexpr uint8_t MaxDepth = %u;\n"
+        "    static constexpr uint8_t NodeCount = %u;\n"
+        "    static constexpr uint8_t SampleDepth = %u;\n"
+        "\n"
+        "    static const ADPS9960::GestureTreeNode* Nodes()\n"
+        "    {\n"
+        "        return %sNodes;\n"
+        "    }\n"
+        "};\n",
+        options.Name,
+        treeDepth(nodes, 0),
+        static_cast<unsigned>(nodes.size()),
+        options.SampleDepth,
+        options.Name);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    std::vector<const char*> inputs;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        const char* option = argv[arg];
+
+        if (strncmp(option, "--", 2) != 0)
+        {
+            inputs.push_back(option);
+            continue;
+        }
+
+        const char* value = (arg + 1 < argc) ? argv[arg + 1] : NULL;
+        if (value == NULL)
+        {
+            printUsage();
+            return 1;
+        }
+        arg++;
+
+        if (strcmp(option, "--depth") == 0)
+        {
+            int depth = atoi(value);
+            options.MaxDepth = static_cast<uint8_t>((depth < 1) ? 1 : (depth > 7) ? 7 : depth);
+        }
+        else if (strcmp(option, "--min-leaf") == 0)
+        {
+            int minLeaf = atoi(value);
+            options.MinLeaf = static_cast<uint16_t>((minLeaf < 1) ? 1 : minLeaf);
+        }
+        else if (strcmp(option, "--sample-depth") == 0)
+        {
+            int sampleDepth = atoi(value);
+            options.SampleDepth = static_cast<uint8_t>((sampleDepth < 1) ? 1 : (sampleDepth > 32) ? 32 : sampleDepth);
+        }
+        else if (strcmp(option, "--name") == 0)
+        {
+            options.Name = value;
+        }
+        else if (strcmp(option, "--out") == 0)
+        {
+            options.OutPath = value;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::vector<Trace> traces;
+
+    if (inputs.empty())
+    {
+        if (!readTraces(stdin, "stdin", traces))
+        {
+            return 1;
+        }
+    }
+    for (const char* input : inputs)
+    {
+        FILE* file = fopen(input, "r");
+        if (file == NULL)
+        {
+            fprintf(stderr, "%s: can't open\n", input);
+            return 1;
+        }
+
+        bool read = readTraces(file, input, traces);
+        fclose(file);
+        if (!read)
+        {
+            return 1;
+        }
+    }
+
+    std::vector<Example> examples;
+    unsigned skipped = 0;
+
+    for (const Trace& trace : traces)
+    {
+        Example example;
+        if (extractExample(trace, options.SampleDepth, &example))
+        {
+            examples.push_back(example);
+        }
+        else
+        {
+            skipped++;
+        }
+    }
+
+    if (skipped)
+    {
+        fprintf(stderr, "skipped %u traces shorter than %u samples\n", skipped, options.SampleDepth * 2);
+    }
+    if (examples.empty())
+    {
+        fprintf(stderr, "no usable traces\n");
+        return 1;
+    }
+
+    TreeBuilder builder(examples, options);
+    builder.Build();
+    const std::vector<GestureTreeNode>& nodes = builder.Nodes();
+
+    // confusion matrix of the training set, rows are the labels
+    unsigned confusion[GestureNameCount][GestureNameCount] = {};
+    unsigned correct = 0;
+
+    for (const Example& example : examples)
+    {
+        uint8_t result = classify(nodes, example.Features);
+        confusion[example.Label][result]++;
+        if (result == example.Label)
+        {
+            correct++;
+        }
+    }
+
+    fprintf(stderr, "%u traces, %u nodes, depth %u, training accuracy %u/%u\n",
+        static_cast<unsigned>(examples.size()),
+        static_cast<unsigned>(nodes.size()),
+        treeDepth(nodes, 0),
+        correct,
+        static_cast<unsigned>(examples.size()));
+    fprintf(stderr, "%-8s", "");
+    for (uint8_t result = 0; result < GestureNameCount; result++)
+    {
+        fprintf(stderr, "%8s", GestureNames[result]);
+    }
+    fprintf(stderr, "\n");
+    for (uint8_t label = 0; label < GestureNameCount; label++)
+    {
+        fprintf(stderr, "%-8s", GestureNames[label]);
+        for (uint8_t result = 0; result < GestureNameCount; result++)
+        {
+            fprintf(stderr, "%8u", confusion[label][result]);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    FILE* out = stdout;
+    if (options.OutPath)
+    {
+        out = fopen(options.OutPath, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "%s: can't create\n", options.OutPath);
+            return 1;
+        }
+    }
+
+    writeHeader(out, options, nodes, examples.size(), correct);
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
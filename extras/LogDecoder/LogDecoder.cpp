@@ -0,0 +1,208 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+// Host command line tool that formats the binary log records written by
+// ADPS_UTIL::LogRing, see src/AdpsLog.h
+//
+// build:
+//    g++ -std=c++11 -O2 -I../../src LogDecoder.cpp -o LogDecoder
+//
+// example:
+//    LogDecoder capture.bin
+//    LogDecoder --hex capture.txt
+//
+// Capture the bytes from LogRing::Drain() raw, or with --hex as text hex
+// bytes (any separators) when the sketch prints them with Serial.print(b, HEX).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "AdpsLog.h"
+
+using namespace ADPS_UTIL;
+
+struct EventFormat
+{
+    const char* Name;
+    const char* Args[LogMaxArgs];
+};
+
+// in LogEvent order
+static const EventFormat EventFormats[] =
+{
+    { "Dropped", { "count" } },
+    { "Start", { "enable" } },
+    { "Register", { "reg", "value" } },
+    { "GestureBegin", { } },
+    { "GestureEnd", { } },
+    { "GestureHeld", { } },
+    { "GestureTooLong", { "ms", "state" } },
+    { "GestureTooShort", { "ms" } },
+    { "GestureIntNoData", { } },
+    { "FifoOverflow", { "lost", "fifo" } },
+};
+
+static void printUsage()
+{
+    printf("usage: LogDecoder [--hex] [capture]\n"
+        "  --hex       the capture is text hex bytes rather than raw binary\n"
+        "the capture is read from stdin when no file is given\n");
+}
+
+// returns the next byte or -1 at the end
+static int nextByte(FILE* file, bool hex)
+{
+    if (!hex)
+    {
+        return fgetc(file);
+    }
+
+    int digits = 0;
+    int value = 0;
+    int c;
+
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (isxdigit(c))
+        {
+            value = (value << 4) | ((c <= '9') ? c - '0' : (tolower(c) - 'a' + 10));
+            if (++digits == 2)
+            {
+                return value;
+            }
+        }
+        else if (digits)
+        {
+            // a single digit, Serial.print(b, HEX) doesn't pad
+            return value;
+        }
+    }
+    return digits ? value : -1;
+}
+
+int main(int argc, char* argv[])
+{
+    bool hex = false;
+    const char* input = NULL;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--hex") == 0)
+        {
+            hex = true;
+        }
+        else if (argv[arg][0] == '-' || input != NULL)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            input = argv[arg];
+        }
+    }
+
+    FILE* file = stdin;
+    if (input)
+    {
+        file = fopen(input, hex ? "r" : "rb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "%s: can't open\n", input);
+            return 1;
+        }
+    }
+
+    unsigned long record = 0;
+    int header;
+
+    while ((header = nextByte(file, hex)) >= 0)
+    {
+        uint8_t event = header & LogEventMask;
+        uint8_t count = header >> LogArgcShift;
+        uint16_t values[LogMaxArgs];
+        bool truncated = false;
+
+        for (uint8_t arg = 0; arg < count; arg++)
+        {
+            int low = nextByte(file, hex);
+            int high = nextByte(file, hex);
+            if (low < 0 || high < 0)
+            {
+                truncated = true;
+                break;
+            }
+            values[arg] = static_cast<uint16_t>(low | (high << 8));
+        }
+        if (truncated)
+        {
+            fprintf(stderr, "record %lu truncated\n", record);
+            break;
+        }
+
+        const EventFormat* format = NULL;
+        if (event < countof(EventFormats))
+        {
+            format = &EventFormats[event];
+            printf("%6lu %s", record, format->Name);
+        }
+        else if (event >= LogEvent_User)
+        {
+            printf("%6lu User%u", record, event - LogEvent_User);
+        }
+        else
+        {
+            printf("%6lu Event%u", record, event);
+        }
+
+        for (uint8_t arg = 0; arg < count; arg++)
+        {
+            const char* name = (format && format->Args[arg]) ? format->Args[arg] : NULL;
+            if (name && strcmp(name, "reg") == 0)
+            {
+                printf(" %s=0x%02X", name, values[arg]);
+            }
+            else if (name)
+            {
+                printf(" %s=%u", name, values[arg]);
+            }
+            else
+            {
+                printf(" %u", values[arg]);
+            }
+        }
+        printf("\n");
+        record++;
+    }
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+// Host command line tool that decodes the compressed blocks written by
+// ADPS_UTIL::TimeSeriesLog, see src/AdpsTimeSeries.h, to CSV
+//
+// build:
+//    g++ -std=c++11 -O2 -I../../src TimeSeriesDecoder.cpp -o TimeSeriesDecoder
+//
+// example:
+//    TimeSeriesDecoder capture.bin > samples.csv
+//    TimeSeriesDecoder --summary --hex capture.txt
+//
+// Capture the bytes from TimeSeriesLog::Drain() or the sealed callback raw,
+// or with --hex as text hex bytes (any separators) when the sketch prints
+// them with Serial.print(b, HEX).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "AdpsTimeSeries.h"
+
+using namespace ADPS_UTIL;
+
+static void printUsage()
+{
+    printf("usage: TimeSeriesDecoder [--hex] [--summary] [capture]\n"
+        "  --hex       the capture is text hex bytes rather than raw binary\n"
+        "  --summary   print the block summaries rather than the samples\n"
+        "the capture is read from stdin when no file is given\n");
+}
+
+// returns the next byte or -1 at the end
+static int nextByte(FILE* file, bool hex)
+{
+    if (!hex)
+    {
+        return fgetc(file);
+    }
+
+    int digits = 0;
+    int value = 0;
+    int c;
+
+    while ((c = fgetc(file)) != EOF)
+    {
+        if (isxdigit(c))
+        {
+            value = (value << 4) | ((c <= '9') ? c - '0' : (tolower(c) - 'a' + 10));
+            if (++digits == 2)
+            {
+                return value;
+            }
+        }
+        else if (digits)
+        {
+            // a single digit, Serial.print(b, HEX) doesn't pad
+            return value;
+        }
+    }
+    return digits ? value : -1;
+}
+
+static bool readBytes(FILE* file, bool hex, uint8_t* bytes, uint16_t count)
+{
+    for (uint16_t index = 0; index < count; index++)
+    {
+        int value = nextByte(file, hex);
+        if (value < 0)
+        {
+            return false;
+        }
+        bytes[index] = static_cast<uint8_t>(value);
+    }
+    return true;
+}
+
+static void printHeader(uint8_t channels, bool summary)
+{
+    printf("sequence");
+    if (summary)
+    {
+        printf(",samples,first,last");
+        for (uint8_t channel = 0; channel < channels; channel++)
+        {
+            printf(",min%u,max%u,mean%u", channel, channel, channel);
+        }
+    }
+    else
+    {
+        printf(",timestamp");
+        for (uint8_t channel = 0; channel < channels; channel++)
+        {
+            printf(",ch%u", channel);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char* argv[])
+{
+    bool hex = false;
+    bool summary = false;
+    const char* input = NULL;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--hex") == 0)
+        {
+            hex = true;
+        }
+        else if (strcmp(argv[arg], "--summary") == 0)
+        {
+            summary = true;
+        }
+        else if (argv[arg][0] == '-' || input != NULL)
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            input = argv[arg];
+        }
+    }
+
+    FILE* file = stdin;
+    if (input)
+    {
+        file = fopen(input, hex ? "r" : "rb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "%s: can't open\n", input);
+            return 1;
+        }
+    }
+
+    // the largest header and a full 16 bit payload length
+    static uint8_t block[TimeSeriesHeaderFixedSize + TimeSeriesMaxChannels * 6 + 8192];
+    unsigned long count = 0;
+    int channelsPrinted = -1;
+    int result = 0;
+
+    while (readBytes(file, hex, block, TimeSeriesHeaderFixedSize))
+    {
+        TimeSeriesBlockReader header(block, TimeSeriesHeaderFixedSize);
+
+        if (block[0] != TimeSeriesMagic ||
+            header.Channels() == 0 ||
+            header.Channels() > TimeSeriesMaxChannels)
+        {
+            fprintf(stderr, "block %lu not a time series block\n", count);
+            result = 1;
+            break;
+        }
+
+        uint16_t size = header.Size();
+        if (!readBytes(file, hex, block + TimeSeriesHeaderFixedSize, size - TimeSeriesHeaderFixedSize))
+        {
+            fprintf(stderr, "block %lu truncated\n", count);
+            result = 1;
+            break;
+        }
+
+        TimeSeriesBlockReader reader(block, size);
+        uint8_t channels = reader.Channels();
+
+        if (channels != channelsPrinted)
+        {
+            printHeader(channels, summary);
+            channelsPrinted = channels;
+        }
+
+        if (summary)
+        {
+            printf("%lu,%u,%lu,%lu",
+                static_cast<unsigned long>(reader.Sequence()),
+                reader.SampleCount(),
+                static_cast<unsigned long>(reader.FirstTimestamp()),
+                static_cast<unsigned long>(reader.LastTimestamp()));
+            for (uint8_t channel = 0; channel < channels; channel++)
+            {
+                printf(",%u,%u,%u", reader.Min(channel), reader.Max(channel), reader.Mean(channel));
+            }
+            printf("\n");
+        }
+        else
+        {
+            uint32_t timestamp;
+            uint16_t values[TimeSeriesMaxChannels];
+            uint16_t decoded = 0;
+
+            while (reader.Next(timestamp, values))
+            {
+                printf("%lu,%lu",
+                    static_cast<unsigned long>(reader.Sequence()),
+                    static_cast<unsigned long>(timestamp));
+                for (uint8_t channel = 0; channel < channels; channel++)
+                {
+                    printf(",%u", values[channel]);
+                }
+                printf("\n");
+                decoded++;
+            }
+            if (decoded != reader.SampleCount())
+            {
+                fprintf(stderr, "block %lu corrupt after %u samples\n", count, decoded);
+                result = 1;
+            }
+        }
+        count++;
+    }
+
+    if (file != stdin)
+    {
+        fclose(file);
+    }
+    return result;
+}
@@ -26,20 +26,33 @@ License along with Rtc.  If not, see
 
 #pragma once
 
-#include <Arduino.h>
+#include "AdpsPlatform.h"
 #include "AdpsUtil.h"
+#include "AdpsClock.h"
 #include "WireUtil.h"
+#include "AdpsRegisterBank.h"
 #include "Adps9930_types.h"
+#include "Adps9930_Timing.h"
 
 namespace ADPS9930
 {
 
-template<class T_WIRE_METHOD> class Adps9930
+// T_RETRY is the retry policy for failed transactions, see WireUtil.h
+//
+template<class T_WIRE_METHOD,
+    class T_RETRY = WIRE_UTIL::RetryNone> class Adps9930
 {
 public:
+    typedef Snapshot SnapshotType;
+    typedef uint16_t ProximityType;
+    static constexpr uint8_t RegisterBankSize = REGISTER_BANK_SIZE;
+
     Adps9930(T_WIRE_METHOD& wire) :
         _wire(wire),
-        _lastError(WIRE_UTIL::Error_None)
+        _lastError(WIRE_UTIL::Error_None),
+        _cycleUs(0),
+        _proximityUs(0),
+        _alsUs(0)
     {
     }
 
@@ -60,6 +73,23 @@ public:
         return _lastError;
     }
 
+    const WIRE_UTIL::Stats& WireStats() const
+    {
+        return _wireStats;
+    }
+
+    void ResetWireStats()
+    {
+        _wireStats = WIRE_UTIL::Stats();
+    }
+
+    // the longest a single register access can take including retries,
+    // given the bound of one attempt, see WIRE_UTIL::TransactionUs
+    static constexpr uint32_t WorstCaseTransactionUs(uint32_t transactionUs)
+    {
+        return T_RETRY::WorstCaseUs(transactionUs);
+    }
+
     void Start(Feature feature = Feature_Proximity_Als,
             bool intEnable = false, 
             bool sleepAfterInt = false)
@@ -136,7 +166,7 @@ public:
             if (msWaitTime >= MIN_LONGWAIT_MS)
             {
                 // using the long wait ranges
-                config |= CONFIG_WLONG;
+                config |= _BV(CONFIG_WLONG);
 
                 float msNormalized = msWaitTime / LONG_WAIT_MULTIPLIER;
                 value = msToTimeReg(msNormalized);
@@ -144,7 +174,7 @@ public:
             else
             {
                 // using the normal wait ranges
-                config &= ~CONFIG_WLONG;
+                config &= ~_BV(CONFIG_WLONG);
                 value = msToTimeReg(msWaitTime);
             }
 
@@ -158,24 +188,28 @@ public:
 
     void SetAlsIntThresholds(uint16_t lowCh0Value, uint16_t highCh0Value)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_AUTO_INC | REG_ALS_INT_THRESHOLDS);
-        _wire.write(lowCh0Value & 0xff);
-        _wire.write(lowCh0Value >> 8);
-        _wire.write(highCh0Value & 0xff);
-        _wire.write(highCh0Value >> 8);
-        _lastError = _wire.endTransmission();
+        uint8_t thresholds[4] = 
+        {
+            static_cast<uint8_t>(lowCh0Value & 0xff),
+            static_cast<uint8_t>(lowCh0Value >> 8),
+            static_cast<uint8_t>(highCh0Value & 0xff),
+            static_cast<uint8_t>(highCh0Value >> 8)
+        };
+
+        writeRegs(REG_ALS_INT_THRESHOLDS, thresholds, sizeof(thresholds));
     }
 
     void SetProximityIntThresholds(uint16_t lowValue, uint16_t highValue)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_AUTO_INC | REG_PROXIMITY_INT_THRESHOLDS);
-        _wire.write(lowValue & 0xff);
-        _wire.write(lowValue >> 8);
-        _wire.write(highValue & 0xff);
-        _wire.write(highValue >> 8);
-        _lastError = _wire.endTransmission();
+        uint8_t thresholds[4] = 
+        {
+            static_cast<uint8_t>(lowValue & 0xff),
+            static_cast<uint8_t>(lowValue >> 8),
+            static_cast<uint8_t>(highValue & 0xff),
+            static_cast<uint8_t>(highValue >> 8)
+        };
+
+        writeRegs(REG_PROXIMITY_INT_THRESHOLDS, thresholds, sizeof(thresholds));
     }
 
     void SetThresholdPersistenceFilterCounts(
@@ -276,37 +310,126 @@ public:
 
     AlsData GetAlsData()
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_AUTO_INC | REG_ALS_DATA);
-        _lastError = _wire.endTransmission();
+        uint8_t data[REG_ALS_DATA_SIZE];
+
+        readRegs(REG_ALS_DATA, data, REG_ALS_DATA_SIZE);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return AlsData();
         }
 
-        uint8_t countRead = this->_wire.requestFrom(I2C_ADDRESS, REG_ALS_DATA_SIZE);
-        if (_lastError != WIRE_UTIL::Error_None ||
-            countRead != REG_ALS_DATA_SIZE)
+        uint16_t ch0 = data[0] + (data[1] << 8);
+        uint16_t ch1 = data[2] + (data[3] << 8);
+
+        return AlsData(ch0, ch1);
+    }
+
+    // the ALS data tagged with its estimated capture time, see
+    // GetProximityData(Timestamped)
+    template<class T_CLOCK = ADPS_UTIL::ClockMillis> void GetAlsData(
+            ADPS_UTIL::Timestamped<AlsData>& als,
+            const T_CLOCK& clock = T_CLOCK())
+    {
+        if (!updateCycleTiming())
         {
-            return AlsData();
+            return;
         }
 
-        uint16_t ch0;
+        AlsData value = GetAlsData();
+        uint32_t readTime = clock.Now();
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            als = ADPS_UTIL::Timestamped<AlsData>(value,
+                ADPS_UTIL::EstimateCaptureTime<T_CLOCK>(readTime, _cycleUs, _alsUs));
+        }
+    }
 
-        ch0 = _wire.read();
-        ch0 += _wire.read() << 8;
+    uint16_t GetProximityData()
+    {
+        return getWord(REG_PROXIMITY_DATA);
+    }
 
-        uint16_t ch1;
+    // the proximity data tagged with its estimated capture time, mid
+    // proximity phase within the last device cycle before the read; the
+    // cycle comes from the timing registers, see CycleUs()
+    template<class T_CLOCK = ADPS_UTIL::ClockMillis> void GetProximityData(
+            ADPS_UTIL::Timestamped<uint16_t>& proximity,
+            const T_CLOCK& clock = T_CLOCK())
+    {
+        if (!updateCycleTiming())
+        {
+            return;
+        }
 
-        ch1 = _wire.read();
-        ch1 += _wire.read() << 8;
+        uint16_t value = GetProximityData();
+        uint32_t readTime = clock.Now();
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            proximity = ADPS_UTIL::Timestamped<uint16_t>(value,
+                ADPS_UTIL::EstimateCaptureTime<T_CLOCK>(readTime, _cycleUs, _proximityUs));
+        }
+    }
 
-        return AlsData(ch0, ch1);
+    // the device cycle from the enabled features, ATIME, PTIME, WTIME,
+    // WLONG and the pulse count; the registers are only read again after
+    // one of them was written
+    uint32_t CycleUs()
+    {
+        updateCycleTiming();
+        return _cycleUs;
     }
 
-    uint16_t GetProximityData()
+    // the shortest proximity cycle, proximity only with the minimum PTIME
+    // and no wait between cycles, for streaming with GetNewProximityData.
+    // PVALID isn't documented to clear on read, so the proximity interrupt
+    // is raised every cycle (thresholds that always trip, no persistence)
+    // to mark new data; the INT pin follows it
+    void StartProximityStream()
     {
-        return getWord(REG_PROXIMITY_DATA);
+        SetProximityAdcTime(MIN_TIME_ADC_MS);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        SetProximityIntThresholds(0xffff, 0xffff);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        uint8_t persistence = getReg(REG_PERSISTENCE);
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            setReg(REG_PERSISTENCE, persistence & PERSISTENCE_APERS_MASK);
+            if (_lastError == WIRE_UTIL::Error_None)
+            {
+                setReg(REG_ENABLE, _BV(ENABLE_PO) | _BV(ENABLE_PEN) | _BV(ENABLE_PIEN));
+                LatchInterrupt(Feature_Proximity);
+            }
+        }
+    }
+
+    // reads the status through the proximity data in one burst, true when
+    // the data is from a cycle completed since the last read, which then
+    // clears the interrupt, see StartProximityStream
+    bool GetNewProximityData(uint16_t& proximity)
+    {
+        uint8_t data[REG_STATUS_PROXIMITY_DATA_SIZE];
+
+        readRegs(REG_STATUS, data, REG_STATUS_PROXIMITY_DATA_SIZE);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return false;
+        }
+
+        proximity = data[REG_STATUS_PROXIMITY_DATA_SIZE - 2] | (data[REG_STATUS_PROXIMITY_DATA_SIZE - 1] << 8);
+        if (!Status(data[0]).IsProximityIntAsserted())
+        {
+            return false;
+        }
+
+        LatchInterrupt(Feature_Proximity);
+        return (_lastError == WIRE_UTIL::Error_None);
     }
 
     void SetProximityOffset(int8_t offset)
@@ -319,10 +442,119 @@ public:
         return getReg(REG_PROXIMITY_OFFSET);
     }
 
+    // reads enable, id, status, ALS and proximity data in one burst so
+    // the liveness checks come for free with the data, see HealthMonitor
+    Snapshot GetSnapshot()
+    {
+        uint8_t regs[SNAPSHOT_SIZE];
+
+        readRegs(SNAPSHOT_FIRST, regs, SNAPSHOT_SIZE);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return Snapshot();
+        }
+        return Snapshot::Decode(regs);
+    }
+
+    // latches the interrupts a snapshot found asserted, so the next
+    // snapshot only shows new cycles, see Snapshot::HasNewData
+    void LatchSnapshot(const Snapshot& snapshot)
+    {
+        uint8_t feature = 0;
+
+        if (snapshot.Status.IsProximityIntAsserted())
+        {
+            feature |= Feature_Proximity;
+        }
+        if (snapshot.Status.IsAlsIntAsserted())
+        {
+            feature |= Feature_AmbiantLightSensor;
+        }
+        if (feature)
+        {
+            LatchInterrupt(static_cast<Feature>(feature));
+        }
+    }
+
+    // reads the register bank, REGISTER_BANK_SIZE bytes from
+    // REGISTER_BANK_FIRST, in as few transactions as the Wire buffer allows
+    void ReadRegisterBank(uint8_t* bank)
+    {
+        readRegs(REGISTER_BANK_FIRST, bank, REGISTER_BANK_SIZE);
+    }
+
+    // compares only the configuration bits, returns the count of registers
+    // that differ and optionally flags them in differences 
+    // (REGISTER_BANK_DIFF_SIZE bytes, bit n is register REGISTER_BANK_FIRST + n)
+    static uint8_t DiffRegisterBank(const uint8_t* bank, 
+            const uint8_t* expected, 
+            uint8_t* differences = NULL)
+    {
+        return ADPS_UTIL::DiffRegisterBank(bank, 
+            expected, 
+            RegisterBankWritable, 
+            REGISTER_BANK_SIZE, 
+            differences);
+    }
+
+    // re-writes only the configuration registers that differ from expected,
+    // the enable register is written last so the device starts with the 
+    // complete configuration
+    void RestoreRegisterBank(const uint8_t* expected)
+    {
+        uint8_t bank[REGISTER_BANK_SIZE];
+        uint8_t differences[REGISTER_BANK_DIFF_SIZE];
+
+        ReadRegisterBank(bank);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        if (DiffRegisterBank(bank, expected, differences) == 0)
+        {
+            return;
+        }
+
+        ADPS_UTIL::MergeRegisterBank(bank, expected, RegisterBankWritable, REGISTER_BANK_SIZE);
+
+        constexpr uint8_t EnableIndex = REG_ENABLE - REGISTER_BANK_FIRST;
+        uint8_t index = EnableIndex + 1;
+
+        while (index < REGISTER_BANK_SIZE)
+        {
+            uint8_t count = ADPS_UTIL::RegisterBankRunLength(differences, 
+                index, 
+                REGISTER_BANK_SIZE, 
+                WIRE_UTIL::BufferLength - 1);
+            if (count)
+            {
+                writeRegs(REGISTER_BANK_FIRST + index, bank + index, count);
+                if (_lastError != WIRE_UTIL::Error_None)
+                {
+                    return;
+                }
+                index += count;
+            }
+            else
+            {
+                index++;
+            }
+        }
+
+        if (ADPS_UTIL::IsRegisterBankDifferent(differences, EnableIndex))
+        {
+            setReg(REG_ENABLE, bank[EnableIndex]);
+        }
+    }
 
 protected:
     T_WIRE_METHOD& _wire;
     uint8_t _lastError;
+    uint32_t _cycleUs; // 0 until read from the timing registers
+    uint32_t _proximityUs;
+    uint32_t _alsUs;
+    T_RETRY _retry;
+    WIRE_UTIL::Stats _wireStats;
 
     // I2C Slave Address  
     const uint8_t I2C_ADDRESS = 0x39;
@@ -346,6 +578,7 @@ protected:
 
     //Register Data Size if not just 1
     static constexpr size_t REG_ALS_DATA_SIZE = 4;
+    static constexpr size_t REG_STATUS_PROXIMITY_DATA_SIZE = 7; // STATUS through PDATAH
  
     // Command Register Flags
     static constexpr uint8_t CMD_TRANSACTION_REPEATED = 0x80;
@@ -384,58 +617,181 @@ protected:
 
     uint8_t getReg(uint8_t regAddress)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_REPEATED | regAddress);
-        _lastError = _wire.endTransmission();
-        if (_lastError != WIRE_UTIL::Error_None)
+        uint8_t regValue = 0;
+
+        readCommand(CMD_TRANSACTION_REPEATED | regAddress, &regValue, 1);
+        return regValue;
+    }
+
+    void setReg(uint8_t regAddress, uint8_t regValue)
+    {
+        invalidateCycleTiming(regAddress, 1);
+        writeCommand(CMD_TRANSACTION_REPEATED | regAddress, &regValue, 1);
+    }
+
+    // burst reads count registers, chunked to the Wire buffer
+    void readRegs(uint8_t regAddress, uint8_t* buffer, uint8_t count)
+    {
+        while (count)
         {
-            return 0;
+            uint8_t chunk = (count > WIRE_UTIL::BufferLength) ? WIRE_UTIL::BufferLength : count;
+
+            readCommand(CMD_TRANSACTION_AUTO_INC | regAddress, buffer, chunk);
+            if (_lastError != WIRE_UTIL::Error_None)
+            {
+                return;
+            }
+            buffer += chunk;
+            regAddress += chunk;
+            count -= chunk;
         }
+    }
 
-        // control register
-        size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, (uint8_t)1);
-        if (1 != bytesRead)
+    // burst writes count registers, chunked to the Wire buffer
+    void writeRegs(uint8_t regAddress, const uint8_t* buffer, uint8_t count)
+    {
+        invalidateCycleTiming(regAddress, count);
+        while (count)
         {
-            _lastError = WIRE_UTIL::Error_Unspecific;
-            return 0;
+            // the command takes one byte of the buffer
+            uint8_t chunk = (count > WIRE_UTIL::BufferLength - 1) ? WIRE_UTIL::BufferLength - 1 : count;
+
+            writeCommand(CMD_TRANSACTION_AUTO_INC | regAddress, buffer, chunk);
+            if (_lastError != WIRE_UTIL::Error_None)
+            {
+                return;
+            }
+            buffer += chunk;
+            regAddress += chunk;
+            count -= chunk;
         }
+    }
 
-        uint8_t regValue = _wire.read();
-        return regValue;
+    // one transaction with retries, count must fit the Wire buffer
+    void readCommand(uint8_t command, uint8_t* buffer, uint8_t count)
+    {
+        for (uint8_t attempt = 0; ; attempt++)
+        {
+            _wire.beginTransmission(I2C_ADDRESS);
+            _wire.write(command);
+            _lastError = _wire.endTransmission();
+            if (_lastError == WIRE_UTIL::Error_None)
+            {
+                size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, count);
+                if (count != bytesRead)
+                {
+                    _lastError = WIRE_UTIL::Error_Unspecific;
+                }
+                else
+                {
+                    for (uint8_t index = 0; index < count; index++)
+                    {
+                        buffer[index] = _wire.read();
+                    }
+                }
+            }
+
+            if (!retry(attempt))
+            {
+                return;
+            }
+        }
     }
 
-    void setReg(uint8_t regAddress, uint8_t regValue)
+    void writeCommand(uint8_t command, const uint8_t* buffer, uint8_t count)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_REPEATED | regAddress);
-        _wire.write(regValue);
-        _lastError = _wire.endTransmission();
+        for (uint8_t attempt = 0; ; attempt++)
+        {
+            _wire.beginTransmission(I2C_ADDRESS);
+            _wire.write(command);
+            for (uint8_t index = 0; index < count; index++)
+            {
+                _wire.write(buffer[index]);
+            }
+            _lastError = _wire.endTransmission();
+
+            if (!retry(attempt))
+            {
+                return;
+            }
+        }
     }
 
-    uint16_t getWord(uint8_t regAddress)
+    // accounts for the attempt just made and returns true if it
+    // failed in a way worth repeating, after backing off
+    bool retry(uint8_t attempt)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(CMD_TRANSACTION_AUTO_INC | regAddress);
-        _lastError = _wire.endTransmission();
-        if (_lastError != WIRE_UTIL::Error_None)
+        if (attempt == 0)
+        {
+            _wireStats.Transactions++;
+        }
+
+        if (_lastError == WIRE_UTIL::Error_None)
         {
-            return 0;
+            return false;
         }
 
-        // control register
-        size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, (uint8_t)2);
-        if (2 != bytesRead)
+        if (attempt + 1 < T_RETRY::MaxAttempts &&
+            WIRE_UTIL::IsTransientError(_lastError))
         {
-            _lastError = WIRE_UTIL::Error_Unspecific;
-            return 0;
+            _wireStats.Retries++;
+            _retry.Backoff(attempt);
+            return true;
         }
 
-        uint16_t result;
+        _wireStats.Failures++;
+        _wireStats.LastFailure = _lastError;
+        return false;
+    }
 
-        result = _wire.read();
-        result += _wire.read() * 256;
+    uint16_t getWord(uint8_t regAddress)
+    {
+        uint8_t word[2] = { 0, 0 };
+
+        readRegs(regAddress, word, 2);
+        return word[0] + word[1] * 256;
+    }
+
+    void invalidateCycleTiming(uint8_t regAddress, uint8_t count)
+    {
+        // the special commands of LatchInterrupt are above this range
+        if (regAddress <= REG_PPULSE && regAddress + count > REG_ENABLE)
+        {
+            _cycleUs = 0;
+        }
+    }
+
+    bool updateCycleTiming()
+    {
+        if (_cycleUs != 0)
+        {
+            return true;
+        }
+
+        uint8_t regs[REG_PPULSE - REG_ENABLE + 1];
+        readRegs(REG_ENABLE, regs, sizeof(regs));
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return false;
+        }
 
-        return result;
+        uint8_t enable = regs[0];
+        uint8_t atime = regs[REG_ATIME - REG_ENABLE];
+        uint8_t ptime = regs[REG_PTIME - REG_ENABLE];
+        uint8_t pulseCount = regs[REG_PPULSE - REG_ENABLE];
+
+        _proximityUs = ProximityPhaseUs(ptime, pulseCount);
+        _alsUs = TimeRegToUs(atime);
+        // zero while powered off, so read again next time
+        _cycleUs = DeviceCycleUs(enable & _BV(ENABLE_PEN),
+            enable & _BV(ENABLE_AEN),
+            enable & _BV(ENABLE_WEN),
+            atime,
+            ptime,
+            regs[REG_WTIME - REG_ENABLE],
+            regs[REG_CONFIG - REG_ENABLE] & _BV(CONFIG_WLONG),
+            pulseCount);
+        return true;
     }
 
     uint8_t msToTimeReg(float msTime)
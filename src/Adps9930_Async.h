@@ -0,0 +1,158 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsAsyncTransaction.h"
+#include "Adps9930_types.h"
+
+namespace ADPS9930
+{
+
+typedef void(*SnapshotCallback)(uint8_t error, const Snapshot& snapshot);
+typedef void(*WriteCallback)(uint8_t error);
+
+// Non blocking requests for an Adps9930 sharing a WIRE_UTIL::AsyncTransactionQueue,
+// see ADPS9960::AsyncAdps9960.  The register is sent as an auto increment
+// command, which the queue advances per chunk like a register.
+//
+template<class T_QUEUE> class AsyncAdps9930
+{
+public:
+    AsyncAdps9930(T_QUEUE& queue) :
+        _queue(queue),
+        _snapshotCallback(NULL),
+        _writeCallback(NULL)
+    {
+    }
+
+    bool RequestSnapshot(SnapshotCallback callback)
+    {
+        if (_snapshotCallback || !callback)
+        {
+            return false;
+        }
+        if (!_queue.Enqueue(I2C_ADDRESS,
+                CMD_TRANSACTION_AUTO_INC | SNAPSHOT_FIRST,
+                WIRE_UTIL::AsyncFlag_Read,
+                _snapshot,
+                SNAPSHOT_SIZE,
+                completeSnapshot,
+                this))
+        {
+            return false;
+        }
+        _snapshotCallback = callback;
+        return true;
+    }
+
+    bool RequestWrite(uint8_t reg, uint8_t value, WriteCallback callback = NULL)
+    {
+        return RequestWriteRegs(reg, &value, 1, callback);
+    }
+
+    // up to WIRE_UTIL::AsyncInlineLength bytes are copied, longer data
+    // must stay valid until the callback
+    bool RequestWriteRegs(uint8_t reg, const uint8_t* data, uint8_t count, WriteCallback callback = NULL)
+    {
+        if (_writeCallback)
+        {
+            return false;
+        }
+
+        uint8_t command = CMD_TRANSACTION_AUTO_INC | reg;
+        bool queued;
+        if (count <= WIRE_UTIL::AsyncInlineLength)
+        {
+            queued = _queue.Enqueue(I2C_ADDRESS, command, WIRE_UTIL::AsyncFlag_None,
+                NULL, count, completeWrite, this, data);
+        }
+        else
+        {
+            queued = _queue.Enqueue(I2C_ADDRESS, command, WIRE_UTIL::AsyncFlag_None,
+                const_cast<uint8_t*>(data), count, completeWrite, this);
+        }
+
+        if (queued)
+        {
+            _writeCallback = callback ? callback : ignoreWrite;
+        }
+        return queued;
+    }
+
+    bool IsSnapshotPending() const
+    {
+        return (_snapshotCallback != NULL);
+    }
+
+    bool IsWritePending() const
+    {
+        return (_writeCallback != NULL);
+    }
+
+protected:
+    static constexpr uint8_t I2C_ADDRESS = 0x39;
+    static constexpr uint8_t CMD_TRANSACTION_AUTO_INC = 0xA0;
+
+    T_QUEUE& _queue;
+    SnapshotCallback _snapshotCallback;
+    WriteCallback _writeCallback;
+
+    uint8_t _snapshot[SNAPSHOT_SIZE];
+
+    static void ignoreWrite(uint8_t /* error */)
+    {
+    }
+
+    static void completeSnapshot(void* context, uint8_t error)
+    {
+        AsyncAdps9930* self = static_cast<AsyncAdps9930*>(context);
+        SnapshotCallback callback = self->_snapshotCallback;
+
+        // cleared first so the callback can request the next one
+        self->_snapshotCallback = NULL;
+        if (error != WIRE_UTIL::Error_None)
+        {
+            callback(error, Snapshot());
+        }
+        else
+        {
+            callback(error, Snapshot::Decode(self->_snapshot));
+        }
+    }
+
+    static void completeWrite(void* context, uint8_t error)
+    {
+        AsyncAdps9930* self = static_cast<AsyncAdps9930*>(context);
+        WriteCallback callback = self->_writeCallback;
+
+        self->_writeCallback = NULL;
+        callback(error);
+    }
+};
+
+} // namespace
@@ -0,0 +1,80 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "Adps9930_types.h"
+
+namespace ADPS9930
+{
+
+// Device timing estimates derived from the datasheet
+// all results are in microseconds and usable at compile time
+//
+// NOTE: the datasheet only gives typical values, runtime code should
+// refine these from observed data
+//
+
+constexpr uint32_t US_ADC_TIME_QUOTUM = 2730;
+constexpr uint32_t US_PROXIMITY_PULSE_PERIOD = 16;
+
+// ATIME, PTIME and WTIME register values, WLONG multiplies the wait by 12
+//
+constexpr uint32_t TimeRegToUs(uint8_t time)
+{
+    return (256 - static_cast<uint32_t>(time)) * US_ADC_TIME_QUOTUM;
+}
+
+constexpr uint32_t WaitTimeRegToUs(uint8_t wtime, bool waitLong)
+{
+    return TimeRegToUs(wtime) * (waitLong ? 12 : 1);
+}
+
+// the LED pulses then the proximity integration
+//
+constexpr uint32_t ProximityPhaseUs(uint8_t ptime, uint8_t pulseCount)
+{
+    return static_cast<uint32_t>(pulseCount) * US_PROXIMITY_PULSE_PERIOD + TimeRegToUs(ptime);
+}
+
+// one device cycle, the proximity phase then the wait and then the ALS
+// integration, each only when enabled
+//
+constexpr uint32_t DeviceCycleUs(bool proximity,
+    bool als,
+    bool wait,
+    uint8_t atime,
+    uint8_t ptime,
+    uint8_t wtime,
+    bool waitLong,
+    uint8_t pulseCount)
+{
+    return (proximity ? ProximityPhaseUs(ptime, pulseCount) : 0) +
+        (wait ? WaitTimeRegToUs(wtime, waitLong) : 0) +
+        (als ? TimeRegToUs(atime) : 0);
+}
+
+} // namespace
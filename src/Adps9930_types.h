@@ -80,6 +80,21 @@ constexpr float MS_ADC_TIME_QUOTUM = 2.73f;
 constexpr uint8_t ALS_ADC_TIME_DEFAULT = 0xf6; // 27.3ms
 constexpr float MS_ALS_ADC_TIME_DEFAULT = MS_ADC_TIME_QUOTUM * (256 - ALS_ADC_TIME_DEFAULT);
 
+// register bank 0x00 - 0x1F, see Adps9930::ReadRegisterBank
+constexpr uint8_t REGISTER_BANK_FIRST = 0x00;
+constexpr uint8_t REGISTER_BANK_SIZE = 32;
+constexpr uint8_t REGISTER_BANK_DIFF_SIZE = (REGISTER_BANK_SIZE + 7) / 8;
+
+// bits of each bank register that are configuration and can be restored,
+// zero for read only and reserved registers
+const uint8_t RegisterBankWritable[REGISTER_BANK_SIZE] PROGMEM =
+{
+    0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x00 ENABLE, ATIME, PTIME, WTIME, AILTL, AILTH, AIHTL, AIHTH
+    0xff, 0xff, 0xff, 0xff, 0xff, 0x07, 0xff, 0xff, // 0x08 PILTL, PILTH, PIHTL, PIHTH, PERS, CONFIG, PPULSE, CONTROL
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x10 -, -, ID, STATUS, C0DATA, C0DATAH, C1DATA, C1DATAH
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, // 0x18 PDATA, PDATAH, -, -, -, -, POFFSET, -
+};
+
 struct Status
 {
     Status(uint8_t status = 0) :
@@ -197,6 +212,69 @@ private:
     }
 };
 
+// the registers needed to check the sensor is alive alongside the data,
+// see GetSnapshot(), read as one burst of ENABLE through PDATAH
+constexpr uint8_t SNAPSHOT_FIRST = 0x00;
+constexpr uint8_t SNAPSHOT_SIZE = 0x19 - SNAPSHOT_FIRST + 1;
+
+struct Snapshot
+{
+    Snapshot() :
+        Enable(0),
+        Id(0),
+        Proximity(0)
+    {
+    }
+
+    bool IsPoweredOn() const
+    {
+        return (Enable & _BV(ENABLE_PON));
+    }
+
+    // true if ALS or proximity are enabled, so new data is expected each cycle
+    bool IsDataExpected() const
+    {
+        return (Enable & (_BV(ENABLE_AEN) | _BV(ENABLE_PEN)));
+    }
+
+    // true if an enabled feature completed a cycle since the interrupts
+    // were last latched (see Adps9930::LatchSnapshot).  AVALID and PVALID
+    // stay set once the first cycle completes, so this relies on AINT and
+    // PINT, which assert every cycle with the persistence at 0 (the power
+    // on default, SetThresholdPersistenceFilterCounts(0, 0))
+    bool HasNewData() const
+    {
+        return ((Enable & _BV(ENABLE_AEN)) && Status.IsAlsIntAsserted()) ||
+            ((Enable & _BV(ENABLE_PEN)) && Status.IsProximityIntAsserted());
+    }
 
+    // decodes the SNAPSHOT_SIZE registers read from SNAPSHOT_FIRST
+    static Snapshot Decode(const uint8_t* regs)
+    {
+        Snapshot result;
+        const uint8_t* als = regs + (0x14 - SNAPSHOT_FIRST);
+        const uint8_t* proximity = regs + (0x18 - SNAPSHOT_FIRST);
+
+        result.Enable = regs[0];
+        result.Id = regs[0x12 - SNAPSHOT_FIRST];
+        result.Status = ADPS9930::Status(regs[0x13 - SNAPSHOT_FIRST]);
+        result.Als = AlsData(als[0] | (als[1] << 8),
+            als[2] | (als[3] << 8));
+        result.Proximity = proximity[0] | (proximity[1] << 8);
+        return result;
+    }
+
+    uint8_t Enable;
+    uint8_t Id;
+    ADPS9930::Status Status;
+    ADPS9930::AlsData Als;
+    uint16_t Proximity;
+
+private:
+    // ENABLE Register Bits
+    static constexpr uint8_t ENABLE_PEN = 2;
+    static constexpr uint8_t ENABLE_AEN = 1;
+    static constexpr uint8_t ENABLE_PON = 0;
+};
 
 } // namespace
\ No newline at end of file
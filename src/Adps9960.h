@@ -26,21 +26,46 @@ License along with Rtc.  If not, see
 
 #pragma once
 
-#include <Arduino.h>
+#include "AdpsPlatform.h"
 #include "AdpsUtil.h"
+#include "AdpsClock.h"
 #include "WireUtil.h"
+#include "AdpsRegisterBank.h"
+#include "AdpsLog.h"
 #include "Adps9960_types.h"
+#include "Adps9960_Orientation.h"
+#include "Adps9960_Timing.h"
 #include "Adps9960_GestureEngine.h"
+#include "Adps9960_GesturePowerManager.h"
+#include "Adps9960_GestureGainControl.h"
+#include "Adps9960_GestureTracker.h"
 
 namespace ADPS9960
 {
 
-template<class T_WIRE_METHOD> class Adps9960
+// T_ORIENTATION remaps the photodiodes for a rotated or mirrored sensor,
+// see Adps9960_Orientation.h
+//
+// T_LOG receives the driver events, see AdpsLog.h
+//
+// T_RETRY is the retry policy for failed transactions, see WireUtil.h
+//
+template<class T_WIRE_METHOD, 
+    class T_ORIENTATION = SensorOrientation_0,
+    class T_LOG = ADPS_UTIL::LogNone,
+    class T_RETRY = WIRE_UTIL::RetryNone> class Adps9960
 {
 public:
+    typedef Snapshot SnapshotType;
+    typedef uint8_t ProximityType;
+    static constexpr uint8_t RegisterBankSize = REGISTER_BANK_SIZE;
+
     Adps9960(T_WIRE_METHOD& wire) :
         _wire(wire),
-        _lastError(WIRE_UTIL::Error_None)
+        _lastError(WIRE_UTIL::Error_None),
+        _cycleUs(0),
+        _proximityUs(0),
+        _alsUs(0)
     {
     }
 
@@ -61,6 +86,28 @@ public:
         return _lastError;
     }
 
+    T_LOG& Log()
+    {
+        return _log;
+    }
+
+    const WIRE_UTIL::Stats& WireStats() const
+    {
+        return _wireStats;
+    }
+
+    void ResetWireStats()
+    {
+        _wireStats = WIRE_UTIL::Stats();
+    }
+
+    // the longest a single register access can take including retries,
+    // given the bound of one attempt, see WIRE_UTIL::TransactionUs
+    static constexpr uint32_t WorstCaseTransactionUs(uint32_t transactionUs)
+    {
+        return T_RETRY::WorstCaseUs(transactionUs);
+    }
+
     void Start(Feature feature = Feature_Gesture_Proximity_Als,
             Feature intEnable = Feature_None,
             bool sleepAfterInt = false)
@@ -107,12 +154,11 @@ public:
                 }
             }
 
-#ifdef ADPS_DEBUG
-            if (feature & Feature_Gesture)
+            _log.Write(ADPS_UTIL::LogEvent_Start, value);
+            if (T_LOG::Enabled && (feature & Feature_Gesture))
             {
-                printGestureRegisters(value);
+                logGestureRegisters();
             }
-#endif
             setReg(REG_ENABLE, value);
 
             if (_lastError == WIRE_UTIL::Error_None)
@@ -188,7 +234,7 @@ public:
             if (msWaitTime >= MIN_LONGWAIT_MS)
             {
                 // using the long wait ranges
-                config |= CONFIG1_WLONG;
+                config |= _BV(CONFIG1_WLONG);
 
                 float msNormalized = msWaitTime / LONG_WAIT_MULTIPLIER;
                 value = msToTimeReg(msNormalized);
@@ -196,7 +242,7 @@ public:
             else
             {
                 // using the normal wait ranges
-                config &= ~CONFIG1_WLONG;
+                config &= ~_BV(CONFIG1_WLONG);
                 value = msToTimeReg(msWaitTime);
             }
 
@@ -210,22 +256,25 @@ public:
 
     void SetAlsIntThresholds(uint16_t lowValue, uint16_t highValue)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_ALS_INT_THRESHOLDS);
-        _wire.write(lowValue & 0xff);
-        _wire.write(lowValue >> 8);
-        _wire.write(highValue & 0xff);
-        _wire.write(highValue >> 8);
-        _lastError = _wire.endTransmission();
+        uint8_t thresholds[4] = 
+        {
+            static_cast<uint8_t>(lowValue & 0xff),
+            static_cast<uint8_t>(lowValue >> 8),
+            static_cast<uint8_t>(highValue & 0xff),
+            static_cast<uint8_t>(highValue >> 8)
+        };
+
+        writeRegs(REG_ALS_INT_THRESHOLDS, thresholds, sizeof(thresholds));
     }
 
     void SetProximityIntThresholds(uint8_t lowValue, uint8_t highValue)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_PROXIMITY_INT_THRESHOLDS);
-        _wire.write(lowValue);
-        _wire.write(highValue);
-            _lastError = _wire.endTransmission();
+        // PILT and PIHT are not adjacent registers
+        setReg(REG_PROXIMITY_INT_THRESHOLD_LOW, lowValue);
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            setReg(REG_PROXIMITY_INT_THRESHOLD_HIGH, highValue);
+        }
     }
 
     void SetThresholdPersistenceFilterCounts(
@@ -344,61 +393,148 @@ public:
 
     AlsData GetAlsData()
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_RGBC_DATA);
-        _lastError = _wire.endTransmission();
+        uint8_t data[REG_RGBC_DATA_SIZE];
+
+        readRegs(REG_RGBC_DATA, data, REG_RGBC_DATA_SIZE);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return AlsData();
         }
 
-        uint8_t countRead = this->_wire.requestFrom(I2C_ADDRESS, REG_RGBC_DATA_SIZE);
-        if (_lastError != WIRE_UTIL::Error_None ||
-            countRead != REG_RGBC_DATA_SIZE)
+        uint16_t clear = data[0] + (data[1] << 8);
+        uint16_t red = data[2] + (data[3] << 8);
+        uint16_t green = data[4] + (data[5] << 8);
+        uint16_t blue = data[6] + (data[7] << 8);
+
+        return AlsData(clear, red, green, blue);
+    }
+
+    // the ALS data tagged with its estimated capture time, see
+    // GetProximityData(Timestamped)
+    template<class T_CLOCK = ADPS_UTIL::ClockMillis> void GetAlsData(
+            ADPS_UTIL::Timestamped<AlsData>& als,
+            const T_CLOCK& clock = T_CLOCK())
+    {
+        if (!updateCycleTiming())
         {
-            return AlsData();
+            return;
         }
 
-        uint16_t clear;
+        AlsData value = GetAlsData();
+        uint32_t readTime = clock.Now();
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            als = ADPS_UTIL::Timestamped<AlsData>(value,
+                ADPS_UTIL::EstimateCaptureTime<T_CLOCK>(readTime, _cycleUs, _alsUs));
+        }
+    }
 
-        clear = _wire.read();
-        clear += _wire.read() << 8;
+    // reads the status and the clear channel in one burst, reading the
+    // data clears AVALID so the clear value is new when the returned
+    // status IsAlsDataValid()
+    Status GetStatusAndClearData(uint16_t& clear)
+    {
+        uint8_t data[REG_STATUS_CLEAR_DATA_SIZE];
 
-        uint16_t red;
+        readRegs(REG_STATUS, data, REG_STATUS_CLEAR_DATA_SIZE);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            clear = 0;
+            return Status();
+        }
 
-        red = _wire.read();
-        red += _wire.read() << 8;
+        clear = data[1] + (data[2] << 8);
+        return Status(data[0]);
+    }
 
-        uint16_t green;
 
-        green = _wire.read();
-        green += _wire.read() << 8;
+    uint8_t GetProximityData()
+    {
+        return getReg(REG_PROXIMITY_DATA);
+    }
 
-        uint16_t blue;
+    // the proximity data tagged with its estimated capture time, mid pulse
+    // phase within the last device cycle before the read; the cycle comes
+    // from the timing registers, see CycleUs()
+    template<class T_CLOCK = ADPS_UTIL::ClockMillis> void GetProximityData(
+            ADPS_UTIL::Timestamped<uint8_t>& proximity,
+            const T_CLOCK& clock = T_CLOCK())
+    {
+        if (!updateCycleTiming())
+        {
+            return;
+        }
 
-        blue = _wire.read();
-        blue += _wire.read() << 8;
+        uint8_t value = GetProximityData();
+        uint32_t readTime = clock.Now();
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            proximity = ADPS_UTIL::Timestamped<uint8_t>(value,
+                ADPS_UTIL::EstimateCaptureTime<T_CLOCK>(readTime, _cycleUs, _proximityUs));
+        }
+    }
 
-        return AlsData(clear, red, green, blue);
+    // the proximity/ALS cycle from the enabled features, ATIME, WTIME,
+    // WLONG and the pulse config; the registers are only read again
+    // after one of them was written
+    uint32_t CycleUs()
+    {
+        updateCycleTiming();
+        return _cycleUs;
     }
 
+    // the shortest proximity cycle, proximity only with no wait between
+    // cycles, for streaming with GetNewProximityData
+    void StartProximityStream()
+    {
+        Start(Feature_Proximity);
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            setReg(REG_ENABLE, _BV(ENABLE_PO) | _BV(ENABLE_PEN));
+        }
+    }
 
-    uint8_t GetProximityData()
+    // true when the proximity data is from a cycle completed since the
+    // last read, reading PDATA clears PVALID.  STATUS and PDATA aren't
+    // adjacent, a burst spanning them would also read CDATA..BDATA and
+    // clear AVALID under an ALS reader, so these are two short reads
+    bool GetNewProximityData(uint8_t& proximity)
     {
-        return getReg(REG_PROXIMITY_DATA);
+        Status status = GetStatus();
+        if (_lastError != WIRE_UTIL::Error_None || !status.IsProximityDataValid())
+        {
+            return false;
+        }
+
+        proximity = getReg(REG_PROXIMITY_DATA);
+        return (_lastError == WIRE_UTIL::Error_None);
     }
 
     void SetProximityOffset(int8_t offsetUpRight, int8_t offsetDownLeft )
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_PROXIMITY_OFFSET);
-        _wire.write(offsetUpRight);
-        _wire.write(offsetDownLeft);
-        _lastError = _wire.endTransmission();
+        static_assert(T_ORIENTATION::IsProximityOffsetMappable(), 
+            "the proximity UR and DL offsets can't be remapped for this sensor orientation");
+
+        if (T_ORIENTATION::IsProximityOffsetSwapped())
+        {
+            int8_t swap = offsetUpRight;
+            offsetUpRight = offsetDownLeft;
+            offsetDownLeft = swap;
+        }
+
+        uint8_t offsets[2] = 
+        {
+            static_cast<uint8_t>(offsetUpRight),
+            static_cast<uint8_t>(offsetDownLeft)
+        };
+
+        writeRegs(REG_PROXIMITY_OFFSET, offsets, sizeof(offsets));
     }
 
     void DisableProximityPhotoDiodes(uint8_t photoDiodeDisableFlags)
     {
+        photoDiodeDisableFlags = T_ORIENTATION::ToPhysical(photoDiodeDisableFlags);
+
         uint8_t value = getReg(REG_CONFIG3);
         if (_lastError == WIRE_UTIL::Error_None)
         {
@@ -423,11 +559,9 @@ public:
     void SetGestureProximityThreshold(uint8_t enter = 30, uint8_t exit = 30)
     {
         enter &= ~_BV(4); // bit four must be set to 0
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_GESTURE_THRESHOLD);
-        _wire.write(enter);
-        _wire.write(exit);
-        _lastError = _wire.endTransmission();
+        uint8_t thresholds[2] = { enter, exit };
+
+        writeRegs(REG_GESTURE_THRESHOLD, thresholds, sizeof(thresholds));
     }
 
     void SetGestureConfig(GestureFifoThreshold fifoThresholdInt = GestureFifoThreshold_Default,
@@ -438,18 +572,49 @@ public:
             GestureWaitTime waitTime = GestureWaitTime_Default)
     {
         uint8_t gconfig1 = (fifoThresholdInt << 6) |
-            ((photoDiodeExcludeExitMask & 0x0f) << 2) |
+            ((T_ORIENTATION::ToPhysical(photoDiodeExcludeExitMask) & 0x0f) << 2) |
             (exitPresistence & 0x03);
         uint8_t gconfig2 = (gain << 5) |
             ((ledDriveCurrent & 0x0f) << 3) |
             (waitTime & 0x07);
 
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_GESTURE_CONFIG);
-        _wire.write(gconfig1);
-        _wire.write(gconfig2);
-        _lastError = _wire.endTransmission();
+        uint8_t gconfig[2] = { gconfig1, gconfig2 };
+
+        writeRegs(REG_GESTURE_CONFIG, gconfig, sizeof(gconfig));
+
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        uint8_t config2 = getReg(REG_CONFIG2);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        config2 &= ~CONFIG2_LEDBOOST_MASK;
+        config2 |= (ledDriveCurrent & 0xf0);
+        setReg(REG_CONFIG2, config2);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+    }
 
+    // changes only the gain and LED drive of the gesture config
+    // NOTE: the LED boost is shared with proximity
+    void SetGestureGainAndDrive(GestureGain gain, LedDriveCurrent ledDriveCurrent)
+    {
+        uint8_t gconfig2 = getReg(REG_GESTURE_CONFIG2);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        gconfig2 &= ~(GESTURE_CONFIG2_GGAIN_MASK | GESTURE_CONFIG2_GLDRIVE_MASK);
+        gconfig2 |= (gain << 5) | ((ledDriveCurrent & 0x0f) << 3);
+        setReg(REG_GESTURE_CONFIG2, gconfig2);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
@@ -464,10 +629,28 @@ public:
         config2 &= ~CONFIG2_LEDBOOST_MASK;
         config2 |= (ledDriveCurrent & 0xf0);
         setReg(REG_CONFIG2, config2);
+    }
+
+    // the LED boost is shared by proximity and gesture, only the boost
+    // of ledDriveCurrent (100%, 150%, 200% or 300%) is written
+    void SetLedBoost(LedDriveCurrent ledDriveCurrent)
+    {
+        uint8_t config2 = getReg(REG_CONFIG2);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
         }
+
+        config2 &= ~CONFIG2_LEDBOOST_MASK;
+        config2 |= (ledDriveCurrent & 0xf0);
+        setReg(REG_CONFIG2, config2);
+    }
+
+    // returns LedDriveCurrent_100mA, _150mA, _200mA or _300mA for the boost
+    LedDriveCurrent GetLedBoost()
+    {
+        uint8_t config2 = getReg(REG_CONFIG2);
+        return static_cast<LedDriveCurrent>(config2 & CONFIG2_LEDBOOST_MASK);
     }
 
     void SetGestureOffset(int8_t offsetUp, 
@@ -475,22 +658,29 @@ public:
             int8_t offsetLeft, 
             int8_t offsetRight)
     {
-        setReg(REG_GESTURE_OFFSET_UP, offsetUp);
+        // logical offsets into physical photodiode order
+        int8_t offsets[GestureData::Count];
+        offsets[T_ORIENTATION::PhysicalUp] = offsetUp;
+        offsets[T_ORIENTATION::PhysicalDown] = offsetDown;
+        offsets[T_ORIENTATION::PhysicalLeft] = offsetLeft;
+        offsets[T_ORIENTATION::PhysicalRight] = offsetRight;
+
+        setReg(REG_GESTURE_OFFSET_UP, offsets[GestureDirection_Up]);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
         }
-        setReg(REG_GESTURE_OFFSET_DOWN, offsetDown);
+        setReg(REG_GESTURE_OFFSET_DOWN, offsets[GestureDirection_Down]);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
         }
-        setReg(REG_GESTURE_OFFSET_LEFT, offsetLeft);
+        setReg(REG_GESTURE_OFFSET_LEFT, offsets[GestureDirection_Left]);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
         }
-        setReg(REG_GESTURE_OFFSET_RIGHT, offsetRight);
+        setReg(REG_GESTURE_OFFSET_RIGHT, offsets[GestureDirection_Right]);
         if (_lastError != WIRE_UTIL::Error_None)
         {
             return;
@@ -517,6 +707,32 @@ public:
         return getReg(REG_GESTURE_FIFO_COUNT);
     }
 
+    // reads both the FIFO level and the gesture status in one transaction
+    uint8_t GetGestureFifoCountAndStatus(GestureStatus& status)
+    {
+        uint8_t regs[2];
+
+        readRegs(REG_GESTURE_FIFO_COUNT, regs, sizeof(regs));
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return 0;
+        }
+
+        status = GestureStatus(regs[1]);
+        return regs[0];
+    }
+
+    void SetGestureFifoThreshold(GestureFifoThreshold fifoThresholdInt)
+    {
+        uint8_t gconfig1 = getReg(REG_GESTURE_CONFIG);
+        if (_lastError == WIRE_UTIL::Error_None)
+        {
+            gconfig1 &= ~GESTURE_CONFIG1_GFIFOTH_MASK;
+            gconfig1 |= (fifoThresholdInt << 6);
+            setReg(REG_GESTURE_CONFIG, gconfig1);
+        }
+    }
+
     GestureStatus GetGestureStatus()
     {
         GestureStatus result;
@@ -533,32 +749,116 @@ public:
     {
         GestureData result;
 
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(REG_GESTURE_DATA);
-        _lastError = _wire.endTransmission();
+        uint8_t data[REG_GESTURE_DATA_SIZE];
+
+        // a retried read after a partial transfer may skip a FIFO sample
+        readRegs(REG_GESTURE_DATA, data, REG_GESTURE_DATA_SIZE);
         if (_lastError == WIRE_UTIL::Error_None)
         {
-            size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, REG_GESTURE_DATA_SIZE);
-            if (REG_GESTURE_DATA_SIZE != bytesRead)
+            result = T_ORIENTATION::ToLogical(GestureData(data[0], data[1], data[2], data[3]));
+        }
+        return result;
+    }
+
+    // reads enable, id, status, ALS and proximity data in one burst so
+    // the liveness checks come for free with the data, see HealthMonitor
+    Snapshot GetSnapshot()
+    {
+        uint8_t regs[SNAPSHOT_SIZE];
+
+        readRegs(SNAPSHOT_FIRST, regs, SNAPSHOT_SIZE);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return Snapshot();
+        }
+        return Snapshot::Decode(regs);
+    }
+
+    // nothing to do, reading the snapshot data cleared AVALID and PVALID
+    void LatchSnapshot(const Snapshot& /* snapshot */)
+    {
+    }
+
+    // reads the register bank, REGISTER_BANK_SIZE bytes from
+    // REGISTER_BANK_FIRST, in as few transactions as the Wire buffer allows
+    void ReadRegisterBank(uint8_t* bank)
+    {
+        readRegs(REGISTER_BANK_FIRST, bank, REGISTER_BANK_SIZE);
+    }
+
+    // compares only the configuration bits, returns the count of registers
+    // that differ and optionally flags them in differences 
+    // (REGISTER_BANK_DIFF_SIZE bytes, bit n is register REGISTER_BANK_FIRST + n)
+    static uint8_t DiffRegisterBank(const uint8_t* bank, 
+            const uint8_t* expected, 
+            uint8_t* differences = NULL)
+    {
+        return ADPS_UTIL::DiffRegisterBank(bank, 
+            expected, 
+            RegisterBankWritable, 
+            REGISTER_BANK_SIZE, 
+            differences);
+    }
+
+    // re-writes only the configuration registers that differ from expected,
+    // the enable register is written last so the device starts with the 
+    // complete configuration
+    void RestoreRegisterBank(const uint8_t* expected)
+    {
+        uint8_t bank[REGISTER_BANK_SIZE];
+        uint8_t differences[REGISTER_BANK_DIFF_SIZE];
+
+        ReadRegisterBank(bank);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        if (DiffRegisterBank(bank, expected, differences) == 0)
+        {
+            return;
+        }
+
+        ADPS_UTIL::MergeRegisterBank(bank, expected, RegisterBankWritable, REGISTER_BANK_SIZE);
+
+        constexpr uint8_t EnableIndex = REG_ENABLE - REGISTER_BANK_FIRST;
+        uint8_t index = EnableIndex + 1;
+
+        while (index < REGISTER_BANK_SIZE)
+        {
+            uint8_t count = ADPS_UTIL::RegisterBankRunLength(differences, 
+                index, 
+                REGISTER_BANK_SIZE, 
+                WIRE_UTIL::BufferLength - 1);
+            if (count)
             {
-                _lastError = WIRE_UTIL::Error_Unspecific;
+                writeRegs(REGISTER_BANK_FIRST + index, bank + index, count);
+                if (_lastError != WIRE_UTIL::Error_None)
+                {
+                    return;
+                }
+                index += count;
             }
             else
             {
-                uint8_t up = _wire.read();
-                uint8_t down = _wire.read();
-                uint8_t left = _wire.read();
-                uint8_t right = _wire.read();
-
-                result = GestureData(up, down, left, right);
+                index++;
             }
         }
-        return result;
+
+        if (ADPS_UTIL::IsRegisterBankDifferent(differences, EnableIndex))
+        {
+            setReg(REG_ENABLE, bank[EnableIndex]);
+        }
     }
 
 protected:
     T_WIRE_METHOD& _wire;
     uint8_t _lastError;
+    T_LOG _log;
+    T_RETRY _retry;
+    WIRE_UTIL::Stats _wireStats;
+    uint32_t _cycleUs; // 0 until read from the timing registers
+    uint32_t _proximityUs;
+    uint32_t _alsUs;
 
     // I2C Slave Address  
     const uint8_t I2C_ADDRESS = 0x39;
@@ -571,7 +871,8 @@ protected:
     // static constexpr uint8_t REG_PTIME = 0x82;
     static constexpr uint8_t REG_WTIME = 0x83;
     static constexpr uint8_t REG_ALS_INT_THRESHOLDS = 0x84;
-    static constexpr uint8_t REG_PROXIMITY_INT_THRESHOLDS = 0x89;
+    static constexpr uint8_t REG_PROXIMITY_INT_THRESHOLD_LOW = 0x89;
+    static constexpr uint8_t REG_PROXIMITY_INT_THRESHOLD_HIGH = 0x8B;
     static constexpr uint8_t REG_PERSISTENCE = 0x8C;
     static constexpr uint8_t REG_CONFIG1 = 0x8D;
     static constexpr uint8_t REG_PPULSE = 0x8E;
@@ -586,6 +887,7 @@ protected:
 
     static constexpr uint8_t REG_GESTURE_THRESHOLD = 0xA0;
     static constexpr uint8_t REG_GESTURE_CONFIG = 0xA2;
+    static constexpr uint8_t REG_GESTURE_CONFIG2 = 0xA3;
     static constexpr uint8_t REG_GESTURE_OFFSET_UP = 0xA4;
     static constexpr uint8_t REG_GESTURE_OFFSET_DOWN = 0xA5;
     static constexpr uint8_t REG_GESTURE_PULSE = 0xA6;
@@ -607,6 +909,7 @@ protected:
     static constexpr size_t REG_ALS_INT_THRESHOLDS_SIZE = 4;
     static constexpr size_t REG_PROXIMITY_INT_THRESHOLDS_SIZE = 4;
     static constexpr size_t REG_RGBC_DATA_SIZE = 8;
+    static constexpr size_t REG_STATUS_CLEAR_DATA_SIZE = 3; // STATUS, CDATAL, CDATAH
     static constexpr size_t REG_PROXIMITY_DATA_SIZE = 4;
     static constexpr size_t REG_GESTURE_DATA_SIZE = 4;
 
@@ -631,8 +934,8 @@ protected:
     // CONFIG2 Register Bits
     static constexpr uint8_t CONFIG2_PSIEN = 7;
     static constexpr uint8_t CONFIG2_CPSIEN = 6;
-    static constexpr uint8_t CONFIG2_SIEN_MASK = 0b1100000;
-    static constexpr uint8_t CONFIG2_LEDBOOST_MASK = 0b0011000;
+    static constexpr uint8_t CONFIG2_SIEN_MASK = 0b11000000;
+    static constexpr uint8_t CONFIG2_LEDBOOST_MASK = 0b00110000;
 
     // CONFIG3 Register Bits
     static constexpr uint8_t CONFIG3_PCMP = 5;
@@ -643,6 +946,13 @@ protected:
     static constexpr uint8_t CONFIG3_PMASK_R = 0;
     static constexpr uint8_t CONFIG3_PBITS_MASK = 0b00101111;
 
+    // GESTURE_CONFIG1 Register Masks
+    static constexpr uint8_t GESTURE_CONFIG1_GFIFOTH_MASK = 0b11000000;
+
+    // GESTURE_CONFIG2 Register Masks
+    static constexpr uint8_t GESTURE_CONFIG2_GGAIN_MASK = 0b01100000;
+    static constexpr uint8_t GESTURE_CONFIG2_GLDRIVE_MASK = 0b00011000;
+
     // GESTURE_CONFIG4 Register Bits
     static constexpr uint8_t GESTURE_CONFIG4_GFIFO_CLEAR = 2;
     static constexpr uint8_t GESTURE_CONFIG4_GIEN = 1;
@@ -654,68 +964,186 @@ protected:
     static constexpr float CONV_TIME_ADC_RATIO = 1.0f / MS_ADC_TIME_QUOTUM;
 
     uint8_t getReg(uint8_t regAddress)
+    {
+        uint8_t regValue = 0;
+
+        readRegs(regAddress, &regValue, 1);
+        return regValue;
+    }
+
+    void setReg(uint8_t regAddress, uint8_t regValue)
+    {
+        writeRegs(regAddress, &regValue, 1);
+    }
+
+    // burst reads count registers, chunked to the Wire buffer
+    void readRegs(uint8_t regAddress, uint8_t* buffer, uint8_t count)
+    {
+        while (count)
+        {
+            uint8_t chunk = (count > WIRE_UTIL::BufferLength) ? WIRE_UTIL::BufferLength : count;
+
+            for (uint8_t attempt = 0; ; attempt++)
+            {
+                readChunk(regAddress, buffer, chunk);
+                if (!retry(attempt))
+                {
+                    break;
+                }
+            }
+            if (_lastError != WIRE_UTIL::Error_None)
+            {
+                return;
+            }
+            buffer += chunk;
+            regAddress += chunk;
+            count -= chunk;
+        }
+    }
+
+    // burst writes count registers, chunked to the Wire buffer
+    void writeRegs(uint8_t regAddress, const uint8_t* buffer, uint8_t count)
+    {
+        if (regAddress <= REG_PPULSE && regAddress + count > REG_ENABLE)
+        {
+            // the device cycle may have changed
+            _cycleUs = 0;
+        }
+
+        while (count)
+        {
+            // the register address takes one byte of the buffer
+            uint8_t chunk = (count > WIRE_UTIL::BufferLength - 1) ? WIRE_UTIL::BufferLength - 1 : count;
+
+            for (uint8_t attempt = 0; ; attempt++)
+            {
+                writeChunk(regAddress, buffer, chunk);
+                if (!retry(attempt))
+                {
+                    break;
+                }
+            }
+            if (_lastError != WIRE_UTIL::Error_None)
+            {
+                return;
+            }
+            buffer += chunk;
+            regAddress += chunk;
+            count -= chunk;
+        }
+    }
+
+    // one transaction each, count must fit the Wire buffer
+    void readChunk(uint8_t regAddress, uint8_t* buffer, uint8_t count)
     {
         _wire.beginTransmission(I2C_ADDRESS);
         _wire.write(regAddress);
         _lastError = _wire.endTransmission();
         if (_lastError != WIRE_UTIL::Error_None)
         {
-            return 0;
+            return;
         }
 
-        // control register
-        size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, (uint8_t)1);
-        if (1 != bytesRead)
+        size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, count);
+        if (count != bytesRead)
         {
             _lastError = WIRE_UTIL::Error_Unspecific;
-            return 0;
+            return;
         }
 
-        uint8_t regValue = _wire.read();
-        return regValue;
+        for (uint8_t index = 0; index < count; index++)
+        {
+            buffer[index] = _wire.read();
+        }
     }
 
-    void setReg(uint8_t regAddress, uint8_t regValue)
+    void writeChunk(uint8_t regAddress, const uint8_t* buffer, uint8_t count)
     {
         _wire.beginTransmission(I2C_ADDRESS);
         _wire.write(regAddress);
-        _wire.write(regValue);
+        for (uint8_t index = 0; index < count; index++)
+        {
+            _wire.write(buffer[index]);
+        }
         _lastError = _wire.endTransmission();
     }
 
-    uint16_t getWord(uint8_t regAddress)
+    // accounts for the attempt just made and returns true if it
+    // failed in a way worth repeating, after backing off
+    bool retry(uint8_t attempt)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(regAddress);
-        _lastError = _wire.endTransmission();
-        if (_lastError != WIRE_UTIL::Error_None)
+        if (attempt == 0)
         {
-            return 0;
+            _wireStats.Transactions++;
         }
 
-        // control register
-        size_t bytesRead = _wire.requestFrom(I2C_ADDRESS, (uint8_t)2);
-        if (2 != bytesRead)
+        if (_lastError == WIRE_UTIL::Error_None)
         {
-            _lastError = WIRE_UTIL::Error_Unspecific;
-            return 0;
+            return false;
         }
 
-        uint16_t result;
+        if (attempt + 1 < T_RETRY::MaxAttempts &&
+            WIRE_UTIL::IsTransientError(_lastError))
+        {
+            _wireStats.Retries++;
+            _retry.Backoff(attempt);
+            return true;
+        }
 
-        result = _wire.read();
-        result += _wire.read() * 256;
+        _wireStats.Failures++;
+        _wireStats.LastFailure = _lastError;
+        return false;
+    }
 
-        return result;
+    uint16_t getWord(uint8_t regAddress)
+    {
+        uint8_t word[2] = { 0, 0 };
+
+        readRegs(regAddress, word, 2);
+        return word[0] + word[1] * 256;
     }
 
     void setWord(uint8_t regAddress, uint16_t wordValue)
     {
-        _wire.beginTransmission(I2C_ADDRESS);
-        _wire.write(regAddress);
-        _wire.write(wordValue & 0xff);
-        _wire.write(wordValue >> 8);
-        _lastError = _wire.endTransmission();
+        uint8_t word[2] = { static_cast<uint8_t>(wordValue & 0xff), static_cast<uint8_t>(wordValue >> 8) };
+
+        writeRegs(regAddress, word, 2);
+    }
+
+    bool updateCycleTiming()
+    {
+        if (_cycleUs != 0)
+        {
+            return true;
+        }
+
+        uint8_t regs[REG_PPULSE - REG_ENABLE + 1];
+        readRegs(REG_ENABLE, regs, sizeof(regs));
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return false;
+        }
+
+        uint8_t enable = regs[0];
+        uint8_t atime = regs[REG_ATIME - REG_ENABLE];
+        uint8_t wtime = regs[REG_WTIME - REG_ENABLE];
+        uint8_t config1 = regs[REG_CONFIG1 - REG_ENABLE];
+        uint8_t pulse = regs[REG_PPULSE - REG_ENABLE];
+        uint8_t pulseCount = (pulse & 0x3f) + 1;
+        ProximityPulseLength pulseLength = static_cast<ProximityPulseLength>(pulse >> 6);
+
+        _proximityUs = ProximityPulsePhaseUs(pulseCount, pulseLength);
+        _alsUs = TimeRegToUs(atime);
+        // zero while powered off, so read again next time
+        _cycleUs = DeviceCycleUs(enable & _BV(ENABLE_PEN),
+            enable & _BV(ENABLE_AEN),
+            enable & _BV(ENABLE_WEN),
+            atime,
+            wtime,
+            config1 & _BV(CONFIG1_WLONG),
+            pulseCount,
+            pulseLength);
+        return true;
     }
 
     uint8_t msToTimeReg(float msTime) const
@@ -755,34 +1183,26 @@ protected:
             AlsGain_Default);
     }
 
-#ifdef ADPS_DEBUG
-    void printReg(uint8_t reg, uint8_t value)
-    {
-        Serial.print(" 0x");
-        Serial.print(reg, HEX);
-        Serial.print(", 0b");
-        Serial.println(value, BIN);
-    }
-
-    void printGestureRegisters(uint8_t enableRegValue)
+    void logGestureRegisters()
     {
         constexpr uint8_t registers[] = { 0x8D, 0x90, 0x93,
-                0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAB, 0xAE, 0xAF,
-                0xFC, 0xFD, 0xFE, 0xFF };
+                0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAB, 0xAE, 0xAF };
         constexpr uint8_t registersCount = sizeof(registers) / sizeof(registers[0]);
-            
-        Serial.println("Gesture Registers: ");
 
-        printReg(REG_ENABLE, enableRegValue);
+        // one burst rather than a transaction per register
+        uint8_t bank[REGISTER_BANK_SIZE];
+        ReadRegisterBank(bank);
+        if (_lastError != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
 
         for (uint8_t regIndex = 0; regIndex < registersCount; regIndex++)
         {
             uint8_t reg = registers[regIndex];
-            uint8_t value = getReg(reg);
-            printReg(reg, value);
+            _log.Write(ADPS_UTIL::LogEvent_Register, reg, bank[reg - REGISTER_BANK_FIRST]);
         }
     }
-#endif
 
 };
 
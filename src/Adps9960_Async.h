@@ -0,0 +1,278 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsAsyncTransaction.h"
+#include "Adps9960_types.h"
+#include "Adps9960_Orientation.h"
+
+namespace ADPS9960
+{
+
+typedef void(*SnapshotCallback)(uint8_t error, const Snapshot& snapshot);
+typedef void(*GestureFifoCallback)(uint8_t error, const GestureData* samples, uint8_t count);
+typedef void(*WriteCallback)(uint8_t error);
+
+// Non blocking requests for an Adps9960 sharing a WIRE_UTIL::AsyncTransactionQueue,
+// for cooperative schedulers where a whole GetSnapshot() or FIFO drain
+// is too long to block.  Each request is queued as transaction descriptors
+// and its callback gets the decoded result from the queue's Service().
+//
+// Configure the sensor with the blocking Adps9960 first, this only covers
+// the periodic traffic.  One request of each kind may be outstanding, a
+// Request returns false while the previous one of that kind is pending or
+// the queue is full.  A FIFO request reserves the descriptor for its
+// sample read when it is made.
+//
+// Queued traffic bypasses the Adps9960: its T_RETRY policy doesn't repeat
+// failed transactions, WireStats() doesn't count them and writes to the
+// timing registers don't invalidate its CycleUs() cache.
+//
+// V_FIFO_SAMPLES limits a drain, the device FIFO holds 32.
+//
+template<class T_QUEUE,
+    class T_ORIENTATION = SensorOrientation_0,
+    uint8_t V_FIFO_SAMPLES = 32> class AsyncAdps9960
+{
+public:
+    static_assert(V_FIFO_SAMPLES > 0 && V_FIFO_SAMPLES <= 63, "V_FIFO_SAMPLES must be 1 to 63");
+    static_assert(WIRE_UTIL::BufferLength % 4 == 0, "FIFO chunks must hold whole samples");
+
+    AsyncAdps9960(T_QUEUE& queue) :
+        _queue(queue),
+        _snapshotCallback(NULL),
+        _fifoCallback(NULL),
+        _writeCallback(NULL),
+        _fifoStage(0)
+    {
+    }
+
+    bool RequestSnapshot(SnapshotCallback callback)
+    {
+        if (_snapshotCallback || !callback)
+        {
+            return false;
+        }
+        if (!_queue.Enqueue(I2C_ADDRESS,
+                SNAPSHOT_FIRST,
+                WIRE_UTIL::AsyncFlag_Read,
+                _snapshot,
+                SNAPSHOT_SIZE,
+                completeSnapshot,
+                this))
+        {
+            return false;
+        }
+        _snapshotCallback = callback;
+        return true;
+    }
+
+    // reads the FIFO level and status, then the available samples in one
+    // burst; the samples are in the logical orientation
+    bool RequestGestureFifo(GestureFifoCallback callback)
+    {
+        if (_fifoCallback || !callback || !_queue.Reserve())
+        {
+            return false;
+        }
+        if (!_queue.Enqueue(I2C_ADDRESS,
+                REG_GESTURE_FIFO_COUNT,
+                WIRE_UTIL::AsyncFlag_Read,
+                _fifoHeader,
+                countof(_fifoHeader),
+                completeFifo,
+                this))
+        {
+            _queue.Release();
+            return false;
+        }
+        _fifoCallback = callback;
+        _fifoStage = 0;
+        return true;
+    }
+
+    bool RequestWrite(uint8_t reg, uint8_t value, WriteCallback callback = NULL)
+    {
+        return RequestWriteRegs(reg, &value, 1, callback);
+    }
+
+    // up to WIRE_UTIL::AsyncInlineLength bytes are copied, longer data
+    // must stay valid until the callback
+    bool RequestWriteRegs(uint8_t reg, const uint8_t* data, uint8_t count, WriteCallback callback = NULL)
+    {
+        if (_writeCallback)
+        {
+            return false;
+        }
+
+        bool queued;
+        if (count <= WIRE_UTIL::AsyncInlineLength)
+        {
+            queued = _queue.Enqueue(I2C_ADDRESS, reg, WIRE_UTIL::AsyncFlag_None,
+                NULL, count, completeWrite, this, data);
+        }
+        else
+        {
+            queued = _queue.Enqueue(I2C_ADDRESS, reg, WIRE_UTIL::AsyncFlag_None,
+                const_cast<uint8_t*>(data), count, completeWrite, this);
+        }
+
+        if (queued)
+        {
+            _writeCallback = callback ? callback : ignoreWrite;
+        }
+        return queued;
+    }
+
+    bool IsSnapshotPending() const
+    {
+        return (_snapshotCallback != NULL);
+    }
+
+    bool IsGestureFifoPending() const
+    {
+        return (_fifoCallback != NULL);
+    }
+
+    bool IsWritePending() const
+    {
+        return (_writeCallback != NULL);
+    }
+
+    // the status read with the last FIFO level, see Adps9960::GetGestureStatus
+    GestureStatus LastGestureStatus() const
+    {
+        return GestureStatus(_fifoHeader[1]);
+    }
+
+protected:
+    static constexpr uint8_t I2C_ADDRESS = 0x39;
+    static constexpr uint8_t REG_GESTURE_FIFO_COUNT = 0xAE;
+    static constexpr uint8_t REG_GESTURE_DATA = 0xFC;
+    static constexpr uint8_t REG_GESTURE_DATA_SIZE = 4;
+
+    T_QUEUE& _queue;
+    SnapshotCallback _snapshotCallback;
+    GestureFifoCallback _fifoCallback;
+    WriteCallback _writeCallback;
+    uint8_t _fifoStage;
+
+    uint8_t _snapshot[SNAPSHOT_SIZE];
+    uint8_t _fifoHeader[2]; // GFLVL, GSTATUS
+    // raw samples are read in place, in the physical U, D, L, R order
+    GestureData _samples[V_FIFO_SAMPLES];
+
+    static void ignoreWrite(uint8_t /* error */)
+    {
+    }
+
+    static void completeSnapshot(void* context, uint8_t error)
+    {
+        AsyncAdps9960* self = static_cast<AsyncAdps9960*>(context);
+        SnapshotCallback callback = self->_snapshotCallback;
+
+        // cleared first so the callback can request the next one
+        self->_snapshotCallback = NULL;
+        if (error != WIRE_UTIL::Error_None)
+        {
+            callback(error, Snapshot());
+        }
+        else
+        {
+            callback(error, Snapshot::Decode(self->_snapshot));
+        }
+    }
+
+    static void completeFifo(void* context, uint8_t error)
+    {
+        AsyncAdps9960* self = static_cast<AsyncAdps9960*>(context);
+        uint8_t count = 0;
+
+        if (self->_fifoStage == 0 &&
+            (error != WIRE_UTIL::Error_None || self->_fifoHeader[0] == 0))
+        {
+            // no samples to read
+            self->_queue.Release();
+        }
+
+        if (error == WIRE_UTIL::Error_None)
+        {
+            if (self->_fifoStage == 0)
+            {
+                count = self->_fifoHeader[0];
+                if (count > V_FIFO_SAMPLES)
+                {
+                    count = V_FIFO_SAMPLES;
+                }
+
+                if (count)
+                {
+                    // burst reads of 0xFC - 0xFF wrap back to 0xFC and pop
+                    // the next sample, so every chunk starts at 0xFC
+                    static_assert(sizeof(GestureData) == REG_GESTURE_DATA_SIZE, "GestureData must be packed");
+
+                    // the descriptor reserved by the request can't be refused
+                    self->_fifoStage = 1;
+                    self->_fifoHeader[0] = count;
+                    self->_queue.Enqueue(I2C_ADDRESS,
+                        REG_GESTURE_DATA,
+                        WIRE_UTIL::AsyncFlag_Read | WIRE_UTIL::AsyncFlag_FixedRegister | WIRE_UTIL::AsyncFlag_Reserved,
+                        reinterpret_cast<uint8_t*>(self->_samples),
+                        count * REG_GESTURE_DATA_SIZE,
+                        completeFifo,
+                        self);
+                    return;
+                }
+            }
+            else
+            {
+                count = self->_fifoHeader[0];
+                for (uint8_t index = 0; index < count; index++)
+                {
+                    self->_samples[index] = T_ORIENTATION::ToLogical(self->_samples[index]);
+                }
+            }
+        }
+
+        GestureFifoCallback callback = self->_fifoCallback;
+
+        self->_fifoCallback = NULL;
+        callback(error, self->_samples, count);
+    }
+
+    static void completeWrite(void* context, uint8_t error)
+    {
+        AsyncAdps9960* self = static_cast<AsyncAdps9960*>(context);
+        WriteCallback callback = self->_writeCallback;
+
+        self->_writeCallback = NULL;
+        callback(error);
+    }
+};
+
+} // namespace
@@ -0,0 +1,201 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+// this file has no Arduino dependencies so it can also be used by host tools
+#include <stdint.h>
+#include <stddef.h>
+#include "AdpsUtil.h"
+#include "Adps9960_Timing.h"
+
+namespace ADPS9960
+{
+
+// Supply current and energy estimates for a device configuration
+//
+// Charge is in pC (uA * us), current in uA and energy in nJ.  The
+// supply currents are the datasheet typical values.  The LED current is
+// drawn from the LEDA supply and is included in the totals.
+//
+// LED_BOOST is shared between proximity and gesture on the device, so the
+// config has one LedBoost and only the current (100, 50, 25 or 12.5mA) of
+// ProximityDrive and GestureDrive is used.  SetGestureConfig leaves the
+// boost at 300%, which then also applies to the proximity pulses.
+//
+
+constexpr uint32_t UA_SUPPLY_ALS_ACTIVE = 200;
+constexpr uint32_t UA_SUPPLY_PROXIMITY_ACTIVE = 790;
+constexpr uint32_t UA_SUPPLY_WAIT = 38;
+constexpr uint32_t UA_SUPPLY_SLEEP = 1;
+
+struct EnergyConfig
+{
+    constexpr EnergyConfig(Feature features = Feature_Proximity_Als,
+            uint8_t atime = ALS_ADC_TIME_DEFAULT,
+            uint8_t wtime = 0xff,
+            bool waitLong = false,
+            LedDriveCurrent ledBoost = LedDriveCurrent_100mA,
+            LedDriveCurrent proximityDrive = LedDriveCurrent_Default,
+            uint8_t proximityPulseCount = 8,
+            ProximityPulseLength proximityPulseLength = ProximityPulseLength_Default,
+            LedDriveCurrent gestureDrive = LedDriveCurrent_GestureDefault,
+            uint8_t gesturePulseCount = 8,
+            ProximityPulseLength gesturePulseLength = ProximityPulseLength_8us,
+            GestureWaitTime gestureWaitTime = GestureWaitTime_Default) :
+        Features(features),
+        ATime(atime),
+        WTime(wtime),
+        WaitLong(waitLong),
+        LedBoost(ledBoost),
+        ProximityDrive(proximityDrive),
+        ProximityPulseCount(proximityPulseCount),
+        ProximityLength(proximityPulseLength),
+        GestureDrive(gestureDrive),
+        GesturePulseCount(gesturePulseCount),
+        GestureLength(gesturePulseLength),
+        GestureWait(gestureWaitTime)
+    {
+    }
+
+    Feature Features;
+    uint8_t ATime; // register value, as set by SetAlsAdcTime
+    uint8_t WTime; // register value, as set by SetWaitTime
+    bool WaitLong;
+    LedDriveCurrent LedBoost; // only the boost is used, LedDriveCurrent_100mA to _300mA
+    LedDriveCurrent ProximityDrive;
+    uint8_t ProximityPulseCount;
+    ProximityPulseLength ProximityLength;
+    LedDriveCurrent GestureDrive;
+    uint8_t GesturePulseCount;
+    ProximityPulseLength GestureLength;
+    GestureWaitTime GestureWait;
+};
+
+constexpr uint32_t LedDriveCurrentToUa(LedDriveCurrent drive)
+{
+    // low two bits select 100/50/25/12.5mA, bits 4-5 the 100/150/200/300% boost
+    return (static_cast<uint32_t>(100000) >> (drive & 0x03)) *
+        (((drive >> 4) & 0x03) == 0 ? 100 :
+         ((drive >> 4) & 0x03) == 1 ? 150 :
+         ((drive >> 4) & 0x03) == 2 ? 200 : 300) / 100;
+}
+
+// the LED current of a proximity or gesture drive with the shared boost
+constexpr uint32_t EnergyLedUa(const EnergyConfig& config, LedDriveCurrent drive)
+{
+    return LedDriveCurrentToUa(static_cast<LedDriveCurrent>((drive & 0x03) | (config.LedBoost & 0x30)));
+}
+
+constexpr uint32_t EnergyAlsUs(const EnergyConfig& config)
+{
+    return (config.Features & Feature_AmbiantLightSensor) ? TimeRegToUs(config.ATime) : 0;
+}
+
+constexpr uint32_t EnergyProximityUs(const EnergyConfig& config)
+{
+    return (config.Features & Feature_Proximity) ?
+        ProximityPulsePhaseUs(config.ProximityPulseCount, config.ProximityLength) : 0;
+}
+
+constexpr uint32_t EnergyWaitUs(const EnergyConfig& config)
+{
+    return WaitTimeRegToUs(config.WTime, config.WaitLong);
+}
+
+// duration of one proximity/ALS cycle, also the time per sample
+//
+constexpr uint32_t EnergyCycleUs(const EnergyConfig& config)
+{
+    return EnergyAlsUs(config) + EnergyProximityUs(config) + EnergyWaitUs(config);
+}
+
+constexpr uint32_t EnergyProximityLedPc(const EnergyConfig& config)
+{
+    return (config.Features & Feature_Proximity) ?
+        EnergyLedUa(config, config.ProximityDrive) *
+            config.ProximityPulseCount *
+            PulseLengthToUs(config.ProximityLength) : 0;
+}
+
+constexpr uint32_t EnergyChargePerCyclePc(const EnergyConfig& config)
+{
+    return EnergyAlsUs(config) * UA_SUPPLY_ALS_ACTIVE +
+        EnergyProximityUs(config) * UA_SUPPLY_PROXIMITY_ACTIVE +
+        EnergyProximityLedPc(config) +
+        EnergyWaitUs(config) * UA_SUPPLY_WAIT;
+}
+
+// the gesture engine runs its own cycles while in gesture mode,
+// the UD and LR pairs are each pulsed
+//
+constexpr uint32_t EnergyGestureCycleUs(const EnergyConfig& config)
+{
+    return GestureCycleUs(config.GestureWait, config.GesturePulseCount, config.GestureLength);
+}
+
+constexpr uint32_t EnergyGestureChargePerCyclePc(const EnergyConfig& config)
+{
+    return GesturePulsePhaseUs(config.GesturePulseCount, config.GestureLength) * UA_SUPPLY_PROXIMITY_ACTIVE +
+        EnergyLedUa(config, config.GestureDrive) *
+            config.GesturePulseCount * 2 *
+            PulseLengthToUs(config.GestureLength) +
+        GestureWaitTimeToUs(config.GestureWait) * UA_SUPPLY_WAIT;
+}
+
+constexpr uint32_t EnergyAverageCurrentUa(const EnergyConfig& config)
+{
+    return (config.Features == Feature_None) ? UA_SUPPLY_SLEEP :
+        EnergyChargePerCyclePc(config) / EnergyCycleUs(config);
+}
+
+constexpr uint32_t EnergyGestureAverageCurrentUa(const EnergyConfig& config)
+{
+    return EnergyGestureChargePerCyclePc(config) / EnergyGestureCycleUs(config);
+}
+
+// average current when gesture mode is active for the given fraction
+// of time (in 1/1000), the rest of the time runs proximity/ALS cycles
+//
+constexpr uint32_t EnergyAverageCurrentUa(const EnergyConfig& config, uint16_t gestureActivePermille)
+{
+    return ((config.Features & Feature_Gesture) ?
+            static_cast<uint64_t>(EnergyGestureAverageCurrentUa(config)) * gestureActivePermille : 0) / 1000 +
+        static_cast<uint64_t>(EnergyAverageCurrentUa(config)) *
+            (1000 - ((config.Features & Feature_Gesture) ? gestureActivePermille : 0)) / 1000;
+}
+
+constexpr uint32_t EnergyPerSampleNj(const EnergyConfig& config, uint16_t supplyMv = 3300)
+{
+    return static_cast<uint64_t>(EnergyChargePerCyclePc(config)) * supplyMv / 1000000;
+}
+
+constexpr uint32_t EnergyPerGestureSampleNj(const EnergyConfig& config, uint16_t supplyMv = 3300)
+{
+    return static_cast<uint64_t>(EnergyGestureChargePerCyclePc(config)) * supplyMv / 1000000;
+}
+
+} // namespace
@@ -0,0 +1,361 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include <math.h>
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+// the flicker of one lamp frequency
+struct FlickerComponent
+{
+    FlickerComponent() :
+        AliasHz(0.0f),
+        ModulationPercent(0.0f),
+        IsResolvable(false)
+    {
+    }
+
+    float AliasHz; // where it lands at the achieved sample rate
+    float ModulationPercent; // corrected for the ALS integration
+    bool IsResolvable; // false when the alias is too close to DC, Nyquist or the other frequency
+};
+
+struct FlickerReport
+{
+    FlickerReport() :
+        SampleRateHz(0.0f),
+        SampleCount(0),
+        MissedSamples(0),
+        Mean(0),
+        Min(0),
+        Max(0),
+        PercentModulation(0.0f),
+        FlickerIndex(0.0f)
+    {
+    }
+
+    float SampleRateHz;
+    uint16_t SampleCount;
+    uint16_t MissedSamples; // device cycles that completed between polls
+    uint16_t Mean;
+    uint16_t Min;
+    uint16_t Max;
+    // (max - min) / (max + min) of the samples, not corrected for the
+    // integration so an underestimate for fast flicker
+    float PercentModulation;
+    // area above the mean over the total area
+    float FlickerIndex;
+    FlickerComponent Flicker100Hz; // 50Hz mains
+    FlickerComponent Flicker120Hz; // 60Hz mains
+};
+
+// Measures lamp flicker from the clear channel.
+//
+// Begin() programs the shortest ALS integration and wait (one 2.78ms
+// quantum each) and only the ALS, so a cycle is about 5.6ms and the
+// device samples near 180Hz.  That is below the 200/240Hz Nyquist rate for
+// 100/120Hz flicker, so each is detected at its alias frequency with a
+// streaming fixed point Goertzel filter.  The exact sample rate comes from
+// the device oscillator, the first CalibrationSamples measure it and each
+// window refines it for the next.
+//
+// Poll() as often as possible, it reads the status and clear data in one
+// burst and returns true when a window of V_WINDOW samples completed and
+// Report() is updated.  Polls slower than the device cycle lose samples,
+// see FlickerReport::MissedSamples.  The clear channel counts at most
+// 1025 per quantum, set the ALS gain for the light level first.
+//
+// Samples are integer only, the float math is once per window.
+//
+template<class T_ADPS,
+    uint16_t V_WINDOW = 256,
+    class T_CLOCK = ADPS_UTIL::ClockMicros> class FlickerAnalyzer
+{
+public:
+    static_assert(V_WINDOW >= 64 && V_WINDOW <= 4096, "V_WINDOW must be 64 to 4096");
+
+    static constexpr uint16_t CalibrationSamples = 32;
+
+    FlickerAnalyzer(T_ADPS& adps) :
+        _adps(adps),
+        _sampleRate(0.0f),
+        _reference(0)
+    {
+        restart();
+    }
+
+    void Begin()
+    {
+        _adps.SetAlsAdcTime(MS_ADC_TIME_QUOTUM);
+        if (_adps.LastError() == WIRE_UTIL::Error_None)
+        {
+            _adps.SetWaitTime(MS_ADC_TIME_QUOTUM);
+            if (_adps.LastError() == WIRE_UTIL::Error_None)
+            {
+                _adps.Start(Feature_AmbiantLightSensor);
+            }
+        }
+
+        _sampleRate = 0.0f;
+        _reference = 0;
+        restart();
+    }
+
+    bool Poll()
+    {
+        uint16_t clear;
+        Status status = _adps.GetStatusAndClearData(clear);
+
+        if (_adps.LastError() != WIRE_UTIL::Error_None || !status.IsAlsDataValid())
+        {
+            return false;
+        }
+        return Add(clear, _clock.Now());
+    }
+
+    // for clear samples read elsewhere, one per device cycle
+    bool Add(uint16_t clear, uint32_t timestamp)
+    {
+        if (_count == 0)
+        {
+            _first = timestamp;
+            if (_reference == 0)
+            {
+                _reference = clear;
+            }
+        }
+        else if (_periodUs)
+        {
+            uint32_t gapUs = ADPS_UTIL::TicksToUs<T_CLOCK>(timestamp - _last);
+
+            if (gapUs > _periodUs + _periodUs / 2)
+            {
+                uint16_t missed = (gapUs + _periodUs / 2) / _periodUs - 1;
+
+                // hold the last sample through the gap, keeps the
+                // detectors in phase with the device
+                _missed += missed;
+                while (missed--)
+                {
+                    _detector100.Add(_previous);
+                    _detector120.Add(_previous);
+                }
+            }
+        }
+        _last = timestamp;
+
+        _sum += clear;
+        if (clear > _reference)
+        {
+            _sumAbove += clear - _reference;
+        }
+        if (clear < _min)
+        {
+            _min = clear;
+        }
+        if (clear > _max)
+        {
+            _max = clear;
+        }
+
+        // centered on the last mean so DC doesn't leak into the bins
+        int32_t sample = static_cast<int32_t>(clear) - _reference;
+        _detector100.Add(sample);
+        _detector120.Add(sample);
+        _previous = sample;
+        _count++;
+
+        if (_sampleRate == 0.0f)
+        {
+            if (_count == CalibrationSamples)
+            {
+                finishWindow();
+            }
+            return false;
+        }
+        if (_count == V_WINDOW)
+        {
+            report();
+            finishWindow();
+            return true;
+        }
+        return false;
+    }
+
+    const FlickerReport& Report() const
+    {
+        return _report;
+    }
+
+protected:
+    static constexpr uint8_t CoeffBits = 14;
+    static constexpr float Pi = 3.14159265f;
+
+    // a Goertzel filter, one bin at an arbitrary frequency
+    class Detector
+    {
+    public:
+        void Start(float frequency, float sampleRate)
+        {
+            Coeff = static_cast<int32_t>(lroundf(2.0f * cosf(2.0f * Pi * frequency / sampleRate) * (1L << CoeffBits)));
+            S1 = 0;
+            S2 = 0;
+        }
+
+        void Add(int32_t sample)
+        {
+            int32_t s = sample + static_cast<int32_t>((static_cast<int64_t>(Coeff) * S1) >> CoeffBits) - S2;
+
+            S2 = S1;
+            S1 = s;
+        }
+
+        // amplitude of the sinusoid at the bin over count samples
+        float Amplitude(uint16_t count) const
+        {
+            float s1 = S1;
+            float s2 = S2;
+            float power = s1 * s1 + s2 * s2 - s1 * s2 * Coeff / (1L << CoeffBits);
+
+            return (power > 0.0f) ? 2.0f * sqrtf(power) / count : 0.0f;
+        }
+
+        int32_t Coeff;
+        int32_t S1;
+        int32_t S2;
+    };
+
+    T_ADPS& _adps;
+    T_CLOCK _clock;
+    float _sampleRate;
+    uint32_t _periodUs;
+    uint16_t _reference; // the last window's mean
+    uint16_t _count;
+    uint16_t _missed;
+    uint16_t _min;
+    uint16_t _max;
+    uint32_t _sum;
+    uint32_t _sumAbove;
+    uint32_t _first;
+    uint32_t _last;
+    int32_t _previous;
+    Detector _detector100;
+    Detector _detector120;
+    FlickerReport _report;
+
+    void restart()
+    {
+        _count = 0;
+        _missed = 0;
+        _min = 0xffff;
+        _max = 0;
+        _sum = 0;
+        _sumAbove = 0;
+        _previous = 0;
+        _periodUs = (_sampleRate > 0.0f) ? static_cast<uint32_t>(1000000.0f / _sampleRate) : 0;
+        _detector100.Start(alias(100.0f), (_sampleRate > 0.0f) ? _sampleRate : 1.0f);
+        _detector120.Start(alias(120.0f), (_sampleRate > 0.0f) ? _sampleRate : 1.0f);
+    }
+
+    // the sample rate and mean of this window set up the next
+    void finishWindow()
+    {
+        uint32_t elapsedUs = ADPS_UTIL::TicksToUs<T_CLOCK>(_last - _first);
+
+        if (elapsedUs)
+        {
+            _sampleRate = (_count - 1 + _missed) * 1000000.0f / elapsedUs;
+        }
+        _reference = _sum / _count;
+        restart();
+    }
+
+    float alias(float frequency) const
+    {
+        if (_sampleRate <= 0.0f)
+        {
+            return 0.0f;
+        }
+
+        float folded = fmodf(frequency, _sampleRate);
+        return (folded > _sampleRate / 2.0f) ? _sampleRate - folded : folded;
+    }
+
+    // the integration is a boxcar of one quantum, a sinc response
+    static float integrationGain(float frequency)
+    {
+        float x = Pi * frequency * MS_ADC_TIME_QUOTUM / 1000.0f;
+
+        return sinf(x) / x;
+    }
+
+    void reportComponent(FlickerComponent& component,
+        const Detector& detector,
+        float frequency,
+        float otherAlias,
+        float mean)
+    {
+        float binHz = _sampleRate / (_count + _missed);
+
+        component.AliasHz = alias(frequency);
+        component.IsResolvable = (component.AliasHz >= 2.0f * binHz) &&
+            (component.AliasHz <= _sampleRate / 2.0f - binHz) &&
+            (fabsf(component.AliasHz - otherAlias) >= 2.0f * binHz);
+        component.ModulationPercent = (mean > 0.0f) ?
+            100.0f * detector.Amplitude(_count + _missed) / (mean * integrationGain(frequency)) :
+            0.0f;
+    }
+
+    void report()
+    {
+        float mean = static_cast<float>(_sum) / _count;
+
+        _report.SampleRateHz = _sampleRate;
+        _report.SampleCount = _count;
+        _report.MissedSamples = _missed;
+        _report.Mean = static_cast<uint16_t>(mean + 0.5f);
+        _report.Min = _min;
+        _report.Max = _max;
+        _report.PercentModulation = (_max + _min) ?
+            100.0f * (_max - _min) / (static_cast<uint32_t>(_max) + _min) :
+            0.0f;
+        _report.FlickerIndex = _sum ? static_cast<float>(_sumAbove) / _sum : 0.0f;
+
+        reportComponent(_report.Flicker100Hz, _detector100, 100.0f, alias(120.0f), mean);
+        reportComponent(_report.Flicker120Hz, _detector120, 120.0f, alias(100.0f), mean);
+    }
+};
+
+} // namespace
@@ -0,0 +1,371 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "AdpsUtil.h"
+#include "Gesture_types.h"
+#include "Adps9960_types.h"
+#include "Adps9960_GestureFeatures.h"
+
+namespace ADPS9960
+{
+
+// Gesture classifier policies for the GestureEngine T_CLASSIFIER
+//
+// A classifier provides
+//    void Entry(const CircularQueue<GestureData>& samples)
+//        given the first V_SAMPLE_DEPTH samples of the gesture
+//    GestureVector Exit(const CircularQueue<GestureData>& samples, uint32_t durationMs)
+//        given the last V_SAMPLE_DEPTH samples when the gesture ends
+//
+// the queues are ordered oldest to newest
+//
+// A classifier that needs a fixed window declares
+//    static constexpr uint8_t SampleDepth
+// and the engine checks it against its V_SAMPLE_DEPTH
+//
+
+// the SampleDepth a classifier declares, 0 when it takes any window
+template<class T_CLASSIFIER> struct GestureClassifierSampleDepth
+{
+    template<class T> static constexpr uint8_t get(decltype(T::SampleDepth)*)
+    {
+        return T::SampleDepth;
+    }
+
+    template<class T> static constexpr uint8_t get(...)
+    {
+        return 0;
+    }
+
+    static constexpr uint8_t Value = get<T_CLASSIFIER>(nullptr);
+};
+
+// the original heuristic, the photodiode with the minimum value on entry
+// and exit votes for a direction weighted toward the ends of the gesture
+//
+class GestureClassifierDirectional
+{
+public:
+    GestureClassifierDirectional(int8_t epsilon = 3) :
+        c_Epsilon(epsilon),
+        _xFirstClass(0),
+        _yFirstClass(0)
+    {
+    }
+
+    void Entry(const CircularQueue<GestureData>& samples)
+    {
+        // reset first classification
+        _xFirstClass = 0;
+        _yFirstClass = 0;
+
+        // include some from first gesture samples in the classification
+        for (size_t iQueue = 0; iQueue < samples.Count; iQueue++)
+        {
+            auto minmax = samples[iQueue].FindMinMax();
+            // importance decreases toward last
+            uint8_t importance = samples.Count - iQueue;
+
+            switch (minmax.MinIndex)
+            {
+            case GestureDirection_Up:
+                _yFirstClass += importance;
+                break;
+            case GestureDirection_Down:
+                _yFirstClass -= importance;
+                break;
+            case GestureDirection_Left:
+                _xFirstClass -= importance;
+                break;
+            case GestureDirection_Right:
+                _xFirstClass += importance;
+                break;
+            }
+        }
+    }
+
+    GestureVector Exit(const CircularQueue<GestureData>& samples, uint32_t /* durationMs */)
+    {
+        // include the last samples into the classification
+        for (size_t iQueue = 0; iQueue < samples.Count; iQueue++)
+        {
+            auto minmax = samples[iQueue].FindMinMax();
+            // importance increases toward last
+            uint8_t importance = iQueue + 2;
+
+            switch (minmax.MinIndex)
+            {
+            case GestureDirection_Up:
+                _yFirstClass -= importance;
+                break;
+            case GestureDirection_Down:
+                _yFirstClass += importance;
+                break;
+            case GestureDirection_Left:
+                _xFirstClass += importance;
+                break;
+            case GestureDirection_Right:
+                _xFirstClass -= importance;
+                break;
+            }
+        }
+
+        // second level classification and
+        // convert into GestureVector for callback
+        GestureVector gesture = GestureVector_Unknown;
+        int8_t absX = abs(_xFirstClass);
+        int8_t absY = abs(_yFirstClass);
+
+        if (absY > absX + c_Epsilon)
+        {
+            // primarily vertical
+            if (_yFirstClass < 0)
+            {
+                gesture = GestureVector_Down;
+            }
+            else
+            {
+                gesture = GestureVector_Up;
+            }
+        }
+        else if (absX > absY + c_Epsilon)
+        {
+            // primarily horizontal
+            if (_xFirstClass < 0)
+            {
+                gesture = GestureVector_Left;
+            }
+            else
+            {
+                gesture = GestureVector_Right;
+            }
+        }
+        return gesture;
+    }
+
+protected:
+    const int8_t c_Epsilon;
+    int8_t _xFirstClass;
+    int8_t _yFirstClass;
+};
+
+// Template matching gesture classifier
+//
+// Each sample is reduced to a ratio point (R-L)/(R+L), (U-D)/(U+D) scaled
+// to +-GestureRatioScale.  The entry and exit points form a path that is
+// compared against a template path per direction with fixed point dynamic
+// time warping, the nearest template within maxDistance wins.
+//
+// The templates live in flash and the working memory is bounded by
+// V_SAMPLE_DEPTH (the path) and the template length (one DTW row).
+//
+constexpr uint8_t GESTURE_TEMPLATE_LENGTH = 8;
+constexpr uint8_t GESTURE_TEMPLATE_COUNT = 4;
+
+// { x, y } per point, in GestureVector order (Up, Down, Left, Right)
+constexpr int8_t GestureTemplates[GESTURE_TEMPLATE_COUNT][GESTURE_TEMPLATE_LENGTH][2] PROGMEM =
+{
+    // Up, y rises from negative to positive
+    { { 0, -48 }, { 0, -40 }, { 0, -28 }, { 0, -10 }, { 0, 10 }, { 0, 28 }, { 0, 40 }, { 0, 48 } },
+    // Down, y falls from positive to negative
+    { { 0, 48 }, { 0, 40 }, { 0, 28 }, { 0, 10 }, { 0, -10 }, { 0, -28 }, { 0, -40 }, { 0, -48 } },
+    // Left, x falls from positive to negative
+    { { 48, 0 }, { 40, 0 }, { 28, 0 }, { 10, 0 }, { -10, 0 }, { -28, 0 }, { -40, 0 }, { -48, 0 } },
+    // Right, x rises from negative to positive
+    { { -48, 0 }, { -40, 0 }, { -28, 0 }, { -10, 0 }, { 10, 0 }, { 28, 0 }, { 40, 0 }, { 48, 0 } },
+};
+
+// V_SAMPLE_DEPTH must match the engine's V_SAMPLE_DEPTH
+//
+template<uint8_t V_SAMPLE_DEPTH = 4> class GestureClassifierTemplate
+{
+public:
+    static constexpr uint8_t SampleDepth = V_SAMPLE_DEPTH;
+
+    GestureClassifierTemplate(uint16_t maxDistance = 640) :
+        c_MaxDistance(maxDistance)
+    {
+    }
+
+    void Entry(const CircularQueue<GestureData>& samples)
+    {
+        addPoints(samples, 0);
+    }
+
+    GestureVector Exit(const CircularQueue<GestureData>& samples, uint32_t /* durationMs */)
+    {
+        addPoints(samples, V_SAMPLE_DEPTH);
+
+        GestureVector gesture = GestureVector_Unknown;
+        uint16_t best = c_MaxDistance;
+
+        for (uint8_t iTemplate = 0; iTemplate < GESTURE_TEMPLATE_COUNT; iTemplate++)
+        {
+            uint16_t distance = dtwDistance(iTemplate);
+            if (distance < best)
+            {
+                best = distance;
+                gesture = static_cast<GestureVector>(iTemplate);
+            }
+        }
+        return gesture;
+    }
+
+protected:
+    static constexpr uint8_t PathLength = V_SAMPLE_DEPTH * 2;
+
+    const uint16_t c_MaxDistance;
+    int8_t _path[PathLength][2];
+
+    void addPoints(const CircularQueue<GestureData>& samples, uint8_t offset)
+    {
+        for (uint8_t index = 0; index < V_SAMPLE_DEPTH; index++)
+        {
+            GestureData data = samples[index];
+
+            _path[offset + index][0] = GestureRatio(data.Right, data.Left);
+            _path[offset + index][1] = GestureRatio(data.Up, data.Down);
+        }
+    }
+
+    uint16_t pointDistance(uint8_t iPath, uint8_t iTemplate, uint8_t iPoint) const
+    {
+        int8_t x = static_cast<int8_t>(pgm_read_byte(&GestureTemplates[iTemplate][iPoint][0]));
+        int8_t y = static_cast<int8_t>(pgm_read_byte(&GestureTemplates[iTemplate][iPoint][1]));
+
+        return abs(_path[iPath][0] - x) + abs(_path[iPath][1] - y);
+    }
+
+    // classic DTW over L1 point distance, keeping only one row
+    uint16_t dtwDistance(uint8_t iTemplate) const
+    {
+        uint16_t row[GESTURE_TEMPLATE_LENGTH];
+
+        // first path point against the template
+        uint16_t accum = 0;
+        for (uint8_t iPoint = 0; iPoint < GESTURE_TEMPLATE_LENGTH; iPoint++)
+        {
+            accum += pointDistance(0, iTemplate, iPoint);
+            row[iPoint] = accum;
+        }
+
+        for (uint8_t iPath = 1; iPath < PathLength; iPath++)
+        {
+            uint16_t diagonal = row[0];
+            row[0] += pointDistance(iPath, iTemplate, 0);
+
+            for (uint8_t iPoint = 1; iPoint < GESTURE_TEMPLATE_LENGTH; iPoint++)
+            {
+                uint16_t up = row[iPoint];
+                uint16_t left = row[iPoint - 1];
+                uint16_t least = diagonal;
+
+                if (up < least)
+                {
+                    least = up;
+                }
+                if (left < least)
+                {
+                    least = left;
+                }
+
+                diagonal = up;
+                row[iPoint] = least + pointDistance(iPath, iTemplate, iPoint);
+            }
+        }
+
+        return row[GESTURE_TEMPLATE_LENGTH - 1];
+    }
+};
+
+// Decision tree gesture classifier
+//
+// T_TREE is generated by extras/GestureTreeTrainer from labeled traces
+// captured on the actual installation (cover glass, bezel), it provides
+//    static constexpr uint8_t MaxDepth
+//    static constexpr uint8_t SampleDepth - the --sample-depth it was trained with
+//    static const GestureTreeNode* Nodes() - the PROGMEM node table
+//
+// Classification is integer only and takes at most MaxDepth comparisons.
+//
+template<class T_TREE> class GestureClassifierDecisionTree
+{
+public:
+    static constexpr uint8_t SampleDepth = T_TREE::SampleDepth;
+
+    void Entry(const CircularQueue<GestureData>& samples)
+    {
+        _features.SetEntry(samples);
+    }
+
+    GestureVector Exit(const CircularQueue<GestureData>& samples, uint32_t durationMs)
+    {
+        _features.SetExit(samples, durationMs);
+        return Classify(_features);
+    }
+
+    static GestureVector Classify(const GestureFeatures& features)
+    {
+        const GestureTreeNode* nodes = T_TREE::Nodes();
+        uint8_t index = 0;
+
+        for (uint8_t depth = 0; depth <= T_TREE::MaxDepth; depth++)
+        {
+            const GestureTreeNode* node = nodes + index;
+            uint8_t feature = pgm_read_byte(&node->Feature);
+
+            if (feature == GestureTreeLeaf)
+            {
+                return static_cast<GestureVector>(pgm_read_byte(&node->Left));
+            }
+
+            int16_t threshold = static_cast<int16_t>(pgm_read_word(&node->Threshold));
+            if (features[feature] <= threshold)
+            {
+                index = pgm_read_byte(&node->Left);
+            }
+            else
+            {
+                index = pgm_read_byte(&node->Right);
+            }
+        }
+
+        // malformed table
+        return GestureVector_Unknown;
+    }
+
+    const GestureFeatures& Features() const
+    {
+        return _features;
+    }
+
+protected:
+    GestureFeatures _features;
+};
+
+} // namespace
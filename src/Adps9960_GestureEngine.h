@@ -26,64 +26,143 @@ License along with Rtc.  If not, see
 
 #pragma once
 
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+#include "AdpsLog.h"
 #include "Gesture_types.h"
+#include "Adps9960_Timing.h"
+#include "Adps9960_GestureClassifiers.h"
 
 namespace ADPS9960
 {
 
-template<class T_ADPS, uint8_t V_SAMPLE_DEPTH = 4> class GestureEngine
+// T_CLOCK is the time source for all gesture timing, see AdpsClock.h;
+// ClockMicros gives finer min/hold/max judgement and ClockVirtual allows
+// deterministic runs on a host
+//
+// T_CLASSIFIER turns the entry and exit samples into a GestureVector,
+// see Adps9960_GestureClassifiers.h
+//
+// T_LOG receives the gesture events, see AdpsLog.h
+//
+template<class T_ADPS, 
+    uint8_t V_SAMPLE_DEPTH = 4, 
+    class T_CLOCK = ADPS_UTIL::ClockMillis,
+    class T_CLASSIFIER = GestureClassifierDirectional,
+    class T_LOG = ADPS_UTIL::LogNone> class GestureEngine
 {
 public:
+    typedef T_CLOCK ClockType;
+
+    static_assert(GestureClassifierSampleDepth<T_CLASSIFIER>::Value == 0 ||
+            GestureClassifierSampleDepth<T_CLASSIFIER>::Value == V_SAMPLE_DEPTH,
+        "T_CLASSIFIER SampleDepth must match V_SAMPLE_DEPTH");
+
     GestureEngine(uint32_t minTimeMs = 44, uint32_t holdTimeMs = 1000, uint32_t maxTimeMs = 1400) :
-        c_MinGestureLengthMs(minTimeMs),
-        c_HoldGestureLengthMs(holdTimeMs),
-        c_MaxGestureLengthMs(maxTimeMs),
+        c_MinGestureLength(ADPS_UTIL::MsToTicks<T_CLOCK>(minTimeMs)),
+        c_HoldGestureLength(ADPS_UTIL::MsToTicks<T_CLOCK>(holdTimeMs)),
+        c_MaxGestureLength(ADPS_UTIL::MsToTicks<T_CLOCK>(maxTimeMs)),
         _state(State_None),
-        _entryMs(0),
+        _entryTime(0),
         _queueSamples(V_SAMPLE_DEPTH),
-        _xFirstClass(0),
-        _yFirstClass(0)
+        _cycleUs(GestureCycleUs(GestureWaitTime_Default)),
+        _fifoThreshold(GestureFifoThreshold_Default),
+        _lastPollTime(0),
+        _nextDeadline(0),
+        _lastDrain(0),
+        _wasActive(false),
+        _fifoTuning(false),
+        _overflowSinceTune(false),
+        _peakFifoLevel(0),
+        _overflowCount(0),
+        _droppedFrames(0),
+        _gestureCount(0),
+        _lastSampleTime(0),
+        _sampleCallback(NULL)
+    {
+    }
+
+    // called for every drained sample with its estimated capture time
+    // in clock ticks, for downstream tracking and sensor fusion
+    void SetSampleCallback(GestureSampleCallback sampleCallback)
     {
+        _sampleCallback = sampleCallback;
     }
 
-    void Process(T_ADPS& adps, GestureCallback callback)
+    // callback is a GestureCallback or any callable taking a GestureVector,
+    // returns the number of samples drained from the FIFO
+    template<typename T_CALLBACK> uint8_t Process(T_ADPS& adps, T_CALLBACK callback)
     {
-        uint32_t processStartMs = millis();
-        uint8_t dataCount = adps.GetGestureFifoCount();
+        uint32_t processStart = _clock.Now();
+        GestureStatus fifoStatus;
+        uint8_t dataCount = adps.GetGestureFifoCountAndStatus(fifoStatus);
+        uint8_t drained = 0;
 
         if (adps.LastError() == WIRE_UTIL::Error_None)
         {
+            if (fifoStatus.IsFifoOverflow())
+            {
+                recoverFifoOverflow(adps, processStart, dataCount);
+                return 0;
+            }
+
+            if (dataCount > _peakFifoLevel)
+            {
+                _peakFifoLevel = dataCount;
+            }
+
+            // the samples were captured one gesture cycle apart with the
+            // newest expected half a cycle before now, work backwards from it
+            uint32_t cycle = ADPS_UTIL::UsToTicks<T_CLOCK>(_cycleUs);
+            uint32_t sampleTime = processStart - cycle / 2 - cycle * (dataCount - 1);
+
+            // keep the last sample time within range so wrap doesn't confuse ordering
+            if ((processStart - _lastSampleTime) > c_MaxGestureLength)
+            {
+                _lastSampleTime = processStart - c_MaxGestureLength;
+            }
+
             while (dataCount--)
             {
                 GestureData data = adps.GetNextGestureData();
                 if (adps.LastError() == WIRE_UTIL::Error_None)
                 {
-                    processGestureData(processStartMs, data);
+                    // samples can't be older than those already drained
+                    if (static_cast<int32_t>(sampleTime - _lastSampleTime) <= 0)
+                    {
+                        sampleTime = _lastSampleTime + 1;
+                    }
+                    _lastSampleTime = sampleTime;
+
+                    processGestureData(sampleTime, data);
+                    if (_sampleCallback)
+                    {
+                        _sampleCallback(data, sampleTime);
+                    }
+                    drained++;
                 }
-                    
+                sampleTime += cycle;
             }
+            _lastDrain = processStart;
 
-            // processGestureData may have reset _entryMs, so we need to
+            // processGestureData may have reset _entryTime, so we need to
             // calc delta after it but before we use it
-            uint32_t deltaMs = processStartMs - _entryMs;
+            uint32_t delta = processStart - _entryTime;
 
             if (_state < State_Held)
             {
-                if (deltaMs > c_MaxGestureLengthMs)
+                if (delta > c_MaxGestureLength)
                 {
-#ifdef ADPS_DEBUG
-                    Serial.print("  too long (");
-                    Serial.print(deltaMs);
-                    Serial.print(") ");
-                    Serial.print(" {");
-                    Serial.print(_state);
-                    Serial.println("}");
-#endif
+                    _log.Write(ADPS_UTIL::LogEvent_GestureTooLong, 
+                        ADPS_UTIL::TicksToMs<T_CLOCK>(delta), 
+                        _state);
                     _state = State_Exit;
                 }
-                else if (deltaMs > c_HoldGestureLengthMs)
+                else if (delta > c_HoldGestureLength)
                 {
                     _state = State_Held;
+                    _log.Write(ADPS_UTIL::LogEvent_GestureHeld);
                     processGestureDataEnd(callback);
                     _state = State_Exit;
                 }
@@ -94,51 +173,55 @@ public:
             {
                 if (!gestureStatus.IsDataValid())
                 {
-                    if (deltaMs < c_MinGestureLengthMs)
+                    if (delta < c_MinGestureLength)
                     {
-#ifdef ADPS_DEBUG
-                        Serial.print("  too short (");
-                        Serial.print(deltaMs);
-                        Serial.println(")");
-#endif
+                        _log.Write(ADPS_UTIL::LogEvent_GestureTooShort, 
+                            ADPS_UTIL::TicksToMs<T_CLOCK>(delta));
                     }
                     else
                     {
                         // exited gesture mode
-#ifdef ADPS_DEBUG
-                        Serial.println("[GEND] ");
-#endif
+                        _log.Write(ADPS_UTIL::LogEvent_GestureEnd);
                         processGestureDataEnd(callback);
                     }
 
+                    // an empty FIFO while idle is not the end of a gesture
+                    if (_state != State_None)
+                    {
+                        _lastSignalStats = _signalStats;
+                        _gestureCount++;
+                    }
                     _state = State_None;
 
+                    if (_fifoTuning)
+                    {
+                        tuneFifoThreshold(adps);
+                    }
+
                     Status status = adps.GetStatus();
                     if (adps.LastError() == WIRE_UTIL::Error_None)
                     {
                         if (status.IsGestureIntAsserted())
                         {
                             adps.LatchInterrupt(Feature_Gesture);
-#ifdef ADPS_DEBUG
-                            Serial.println("ADPS in int assert with no data?");
-#endif
+                            _log.Write(ADPS_UTIL::LogEvent_GestureIntNoData);
                         }
                     }
                 }
 
             }
         }
+        return drained;
     }
 
-    void Poll(T_ADPS& adps, GestureCallback callback, uint32_t pollIntervalMs)
+    template<typename T_CALLBACK> void Poll(T_ADPS& adps, T_CALLBACK callback, uint32_t pollIntervalMs)
     {
-        static uint32_t LastPollTime = 0;
-        uint32_t now = millis();
-        uint32_t delta = (now - LastPollTime);
+        uint32_t now = _clock.Now();
+        uint32_t delta = (now - _lastPollTime);
 
-        if (delta >= pollIntervalMs)
+        if (delta >= ADPS_UTIL::MsToTicks<T_CLOCK>(pollIntervalMs))
         {
-            LastPollTime = now;
+            _lastPollTime = now;
 
             GestureStatus gestureStatus = adps.GetGestureStatus();
             if (adps.LastError() == WIRE_UTIL::Error_None)
@@ -151,6 +234,156 @@ public:
         }
     }
 
+    // provide the gesture timing that was configured on the device
+    // so PollAdaptive() can predict when the FIFO needs to be serviced,
+    // the arguments match those given to SetGestureConfig/SetGesturePulseConfig
+    void SetGestureTiming(GestureWaitTime waitTime = GestureWaitTime_Default,
+            GestureFifoThreshold fifoThreshold = GestureFifoThreshold_Default,
+            uint8_t pulseCount = 8,
+            ProximityPulseLength pulseLength = ProximityPulseLength_8us)
+    {
+        _cycleUs = GestureCycleUs(waitTime, pulseCount, pulseLength);
+        _fifoThreshold = fifoThreshold;
+    }
+
+    // when enabled, the FIFO threshold is retuned at the end of each gesture
+    // to the highest level (lowest interrupt rate) that still leaves headroom
+    // for the measured service latency, overflows step it down
+    void EnableFifoThresholdTuning(bool enable = true)
+    {
+        _fifoTuning = enable;
+    }
+
+    GestureFifoThreshold FifoThreshold() const
+    {
+        return _fifoThreshold;
+    }
+
+    // number of times the FIFO was found overflowed and recovered
+    uint32_t OverflowCount() const
+    {
+        return _overflowCount;
+    }
+
+    // estimate of gesture samples lost to overflows, 
+    // including those discarded by the recovery
+    uint32_t DroppedFrames() const
+    {
+        return _droppedFrames;
+    }
+
+    void ResetFifoStats()
+    {
+        _overflowCount = 0;
+        _droppedFrames = 0;
+    }
+
+    // incremented each time a gesture ends, 
+    // LastGestureSignalStats() then describes that gesture
+    uint32_t GestureCount() const
+    {
+        return _gestureCount;
+    }
+
+    const GestureSignalStats& LastGestureSignalStats() const
+    {
+        return _lastSignalStats;
+    }
+
+    // poll slowly while no gesture is present, then while a gesture is active
+    // poll so the FIFO is drained just before it reaches the threshold level
+    template<typename T_CALLBACK> void PollAdaptive(T_ADPS& adps, T_CALLBACK callback, uint32_t idleIntervalMs = 100)
+    {
+        uint32_t now = _clock.Now();
+        uint32_t idleInterval = ADPS_UTIL::MsToTicks<T_CLOCK>(idleIntervalMs);
+
+        if (!ADPS_UTIL::IsTimeReached(now, _nextDeadline))
+        {
+            return;
+        }
+
+        if (_state == State_None)
+        {
+            GestureStatus gestureStatus = adps.GetGestureStatus();
+            if (adps.LastError() != WIRE_UTIL::Error_None ||
+                !gestureStatus.IsDataValid())
+            {
+                _wasActive = false;
+                _nextDeadline = now + idleInterval;
+                return;
+            }
+        }
+
+        uint32_t sinceDrain = now - _lastDrain;
+        uint8_t drained = Process(adps, callback);
+
+        // refine the cycle estimate from the observed FIFO level, 
+        // a full FIFO has lost samples and can't be trusted
+        if (_wasActive && drained > 1 && drained < GESTURE_FIFO_DEPTH)
+        {
+            uint32_t observedUs = ADPS_UTIL::TicksToUs<T_CLOCK>(sinceDrain) / drained;
+            _cycleUs = (_cycleUs * 3 + observedUs) / 4;
+        }
+
+        if (_state == State_None)
+        {
+            _wasActive = false;
+            _nextDeadline = now + idleInterval;
+        }
+        else
+        {
+            // aim half a cycle before the threshold level would be reached
+            uint32_t untilThresholdUs = _cycleUs * GestureFifoThresholdToLevel(_fifoThreshold) - _cycleUs / 2;
+            uint32_t interval = ADPS_UTIL::UsToTicks<T_CLOCK>(untilThresholdUs);
+
+            if (interval < 1)
+            {
+                interval = 1;
+            }
+            else if (interval > idleInterval)
+            {
+                interval = idleInterval;
+            }
+
+            _wasActive = true;
+            _nextDeadline = now + interval;
+        }
+    }
+
+    // the clock time PollAdaptive() next needs to be called,
+    // cooperative schedulers can sleep until then
+    uint32_t NextDeadline() const
+    {
+        return _nextDeadline;
+    }
+
+    // the same as NextDeadline() but in ms, this matches millis() 
+    // only when using ClockMillis
+    uint32_t NextDeadlineMs() const
+    {
+        return ADPS_UTIL::TicksToMs<T_CLOCK>(_nextDeadline);
+    }
+
+    T_CLOCK& Clock()
+    {
+        return _clock;
+    }
+
+    T_CLASSIFIER& Classifier()
+    {
+        return _classifier;
+    }
+
+    T_LOG& Log()
+    {
+        return _log;
+    }
+
+    bool IsActive() const
+    {
+        return (_state != State_None);
+    }
+
 protected:
     enum State
     {
@@ -163,58 +396,132 @@ protected:
         State_Exit,
     };
 
-    const uint32_t c_MinGestureLengthMs;
-    const uint32_t c_HoldGestureLengthMs;
-    const uint32_t c_MaxGestureLengthMs;
+    // all times are in T_CLOCK ticks
+    const uint32_t c_MinGestureLength;
+    const uint32_t c_HoldGestureLength;
+    const uint32_t c_MaxGestureLength;
+
+    T_CLOCK _clock;
+    T_CLASSIFIER _classifier;
+    T_LOG _log;
 
     uint8_t _state;
-    uint32_t _entryMs;
+    uint32_t _entryTime;
     
     CircularQueue<GestureData> _queueSamples;
-    int8_t _xFirstClass;
-    int8_t _yFirstClass;
 
-    void processGestureDataEnd(GestureCallback callback)
+    uint32_t _cycleUs;
+    GestureFifoThreshold _fifoThreshold;
+    uint32_t _lastPollTime;
+    uint32_t _nextDeadline;
+    uint32_t _lastDrain;
+    bool _wasActive;
+
+    bool _fifoTuning;
+    bool _overflowSinceTune;
+    uint8_t _peakFifoLevel;
+    uint32_t _overflowCount;
+    uint32_t _droppedFrames;
+
+    uint32_t _gestureCount;
+    GestureSignalStats _signalStats;
+    GestureSignalStats _lastSignalStats;
+
+    uint32_t _lastSampleTime;
+    GestureSampleCallback _sampleCallback;
+
+    void recoverFifoOverflow(T_ADPS& adps, uint32_t processStart, uint8_t fifoCount)
     {
-        if (_state == State_Over_Last)
+        // samples produced while the FIFO was full were lost, this can only
+        // be estimated while a gesture was being tracked
+        uint32_t lost = 1;
+        if (_state != State_None)
         {
-            // we have collected enough to make an informed guess at the gesture
-            //
+            uint32_t produced = ADPS_UTIL::TicksToUs<T_CLOCK>(processStart - _lastDrain) / _cycleUs;
+            if (produced > GESTURE_FIFO_DEPTH)
+            {
+                lost = produced - GESTURE_FIFO_DEPTH;
+            }
+        }
+
+        _log.Write(ADPS_UTIL::LogEvent_FifoOverflow, lost, fifoCount);
+        _overflowCount++;
+        _droppedFrames += lost + fifoCount;
+        _overflowSinceTune = true;
 
-            updateExitFirstClassification();
+        // clearing the FIFO also clears GFOV and GVALID, the partial gesture
+        // is abandoned so the state machine syncs on the next gesture entry
+        adps.LatchInterrupt(Feature_Gesture);
+        _state = State_None;
+        _lastDrain = processStart;
+
+        if (_fifoTuning)
+        {
+            tuneFifoThreshold(adps);
+        }
+    }
 
-            // second level classification and
-            // convert into GestureVector for callback
-            GestureVector gesture = GestureVector_Unknown;
-            int8_t epsilon = 3;
-            int8_t absX = abs(_xFirstClass);
-            int8_t absY = abs(_yFirstClass);
+    void tuneFifoThreshold(T_ADPS& adps)
+    {
+        uint8_t tuned = _fifoThreshold;
 
-            if (absY > absX + epsilon)
+        if (_overflowSinceTune)
+        {
+            if (tuned > GestureFifoThreshold_1)
             {
-                // primarily vertical
-                if (_yFirstClass < 0)
-                {
-                    gesture = GestureVector_Down;
-                }
-                else
-                {
-                    gesture = GestureVector_Up;
-                }
+                tuned--;
             }
-            else if (absX > absY + epsilon)
+        }
+        else if (_peakFifoLevel != 0)
+        {
+            // samples that arrived after the threshold level was reached
+            // but before the FIFO was serviced
+            uint8_t level = GestureFifoThresholdToLevel(_fifoThreshold);
+            uint8_t latency = (_peakFifoLevel > level) ? (_peakFifoLevel - level) : 0;
+
+            // highest threshold that leaves twice the latency as headroom
+            uint8_t candidate = GestureFifoThreshold_16;
+            while (candidate > GestureFifoThreshold_1 &&
+                GestureFifoThresholdToLevel(static_cast<GestureFifoThreshold>(candidate)) +
+                    latency * 2 >= GESTURE_FIFO_DEPTH)
             {
-                // primarily horizontal
-                if (_xFirstClass < 0)
-                {
-                    gesture = GestureVector_Left;
-                }
-                else
-                {
-                    gesture = GestureVector_Right;
-                }
+                candidate--;
             }
 
+            // raise slowly, lower immediately
+            if (candidate > tuned)
+            {
+                tuned++;
+            }
+            else
+            {
+                tuned = candidate;
+            }
+        }
+
+        _overflowSinceTune = false;
+        _peakFifoLevel = 0;
+
+        if (tuned != _fifoThreshold)
+        {
+            adps.SetGestureFifoThreshold(static_cast<GestureFifoThreshold>(tuned));
+            if (adps.LastError() == WIRE_UTIL::Error_None)
+            {
+                _fifoThreshold = static_cast<GestureFifoThreshold>(tuned);
+            }
+        }
+    }
+
+    template<typename T_CALLBACK> void processGestureDataEnd(T_CALLBACK& callback)
+    {
+        if (_state == State_Over_Last)
+        {
+            // we have collected enough to make an informed guess at the gesture
+            //
+
+            GestureVector gesture = _classifier.Exit(_queueSamples,
+                ADPS_UTIL::TicksToMs<T_CLOCK>(_lastSampleTime - _entryTime));
+
             callback(gesture);
         }
         else if (_state == State_Held)
@@ -223,16 +530,20 @@ protected:
         }
     }
 
-    void processGestureData(uint32_t processStartMs, GestureData data)
+    void processGestureData(uint32_t sampleTime, GestureData data)
     {
+        if (_state == State_None)
+        {
+            _signalStats = GestureSignalStats();
+        }
+        _signalStats.Add(data);
+
         if (_state < State_Held)
         {
             if (_state == State_None)
             {
-#ifdef ADPS_DEBUG
-                Serial.println("[GBEGIN] ");
-#endif
-                _entryMs = processStartMs;
+                _log.Write(ADPS_UTIL::LogEvent_GestureBegin);
+                _entryTime = sampleTime;
 
                 // prepare queue for gesture entry samples
                 _queueSamples.Clear();
@@ -244,11 +555,7 @@ protected:
                 _queueSamples.Enqueue(data);
                 if (_state == State_Entry_Last)
                 {
-                    // reset first classification
-                    _xFirstClass = 0;
-                    _yFirstClass = 0;
-
-                    updateEntryFirstClassification();
+                    _classifier.Entry(_queueSamples);
 
                     // prepare queue for gesture exit samples
                     _queueSamples.Clear();
@@ -265,60 +572,6 @@ protected:
             }
         }
     }
-
-    void updateEntryFirstClassification()
-    {
-        // include some from first gesture samples in the classification
-        for (size_t iQueue = 0; iQueue < _queueSamples.Count; iQueue++)
-        {
-            auto minmax = _queueSamples[iQueue].FindMinMax();
-            // importance decreases toward last
-            uint8_t importance = _queueSamples.Count - iQueue; 
-
-            switch (minmax.MinIndex)
-            {
-            case GestureDirection_Up:
-                _yFirstClass += importance;
-                break;
-            case GestureDirection_Down:
-                _yFirstClass -= importance;
-                break;
-            case GestureDirection_Left:
-                _xFirstClass -= importance;
-                break;
-            case GestureDirection_Right:
-                _xFirstClass += importance;
-                break;
-            }
-        }
-    }
-
-    void updateExitFirstClassification()
-    {
-        // include the last samples into the classification
-        for (size_t iQueue = 0; iQueue < _queueSamples.Count; iQueue++)
-        {
-            auto minmax = _queueSamples[iQueue].FindMinMax();
-            // importance increases toward last
-            uint8_t importance = iQueue + 2; 
-
-            switch (minmax.MinIndex)
-            {
-            case GestureDirection_Up:
-                _yFirstClass -= importance;
-                break;
-            case GestureDirection_Down:
-                _yFirstClass += importance;
-                break;
-            case GestureDirection_Left:
-                _xFirstClass += importance;
-                break;
-            case GestureDirection_Right:
-                _xFirstClass -= importance;
-                break;
-            }
-        }
-    }
 };
 
 }
\ No newline at end of file
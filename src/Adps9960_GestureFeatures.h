@@ -0,0 +1,164 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "AdpsUtil.h"
+#include "Adps9960_types.h"
+#include "Gesture_types.h"
+
+namespace ADPS9960
+{
+
+// Cheap per gesture features computed from the entry and exit sample
+// windows of the GestureEngine.  Shared by the device classifiers and the
+// host trainer (extras/GestureTreeTrainer) so both see identical values.
+//
+enum GestureFeature
+{
+    GestureFeature_EntryMin, // GestureDirection of the weakest channel on entry
+    GestureFeature_ExitMin, // GestureDirection of the weakest channel on exit
+    GestureFeature_EntryX, // mean (R-L)/(R+L) on entry, +-GestureRatioScale
+    GestureFeature_EntryY, // mean (U-D)/(U+D) on entry
+    GestureFeature_ExitX,
+    GestureFeature_ExitY,
+    GestureFeature_SlopeX, // ExitX - EntryX
+    GestureFeature_SlopeY, // ExitY - EntryY
+    GestureFeature_DurationMs,
+
+    GestureFeature_Count
+};
+
+constexpr int8_t GestureRatioScale = 64;
+
+// (a-b)/(a+b) scaled to +-GestureRatioScale, 0 when there is no signal
+inline int8_t GestureRatio(uint8_t a, uint8_t b)
+{
+    int16_t sum = static_cast<int16_t>(a) + b;
+    if (sum == 0)
+    {
+        return 0;
+    }
+    return static_cast<int8_t>((static_cast<int16_t>(a) - b) * GestureRatioScale / sum);
+}
+
+struct GestureFeatures
+{
+    GestureFeatures()
+    {
+        for (uint8_t feature = 0; feature < GestureFeature_Count; feature++)
+        {
+            Values[feature] = 0;
+        }
+    }
+
+    void SetEntry(const CircularQueue<GestureData>& samples)
+    {
+        setWindow(samples,
+            GestureFeature_EntryMin,
+            GestureFeature_EntryX,
+            GestureFeature_EntryY);
+    }
+
+    void SetExit(const CircularQueue<GestureData>& samples, uint32_t durationMs)
+    {
+        setWindow(samples,
+            GestureFeature_ExitMin,
+            GestureFeature_ExitX,
+            GestureFeature_ExitY);
+
+        Values[GestureFeature_SlopeX] = Values[GestureFeature_ExitX] - Values[GestureFeature_EntryX];
+        Values[GestureFeature_SlopeY] = Values[GestureFeature_ExitY] - Values[GestureFeature_EntryY];
+        Values[GestureFeature_DurationMs] = (durationMs > 0x7fff) ? 0x7fff : static_cast<int16_t>(durationMs);
+    }
+
+    int16_t operator[](size_t idx) const
+    {
+        if (idx >= GestureFeature_Count)
+        {
+            idx = GestureFeature_Count - 1;
+        }
+        return Values[idx];
+    }
+
+    int16_t Values[GestureFeature_Count];
+
+private:
+    void setWindow(const CircularQueue<GestureData>& samples,
+        GestureFeature featureMin,
+        GestureFeature featureX,
+        GestureFeature featureY)
+    {
+        uint16_t sums[GestureData::Count] = { 0, 0, 0, 0 };
+        int16_t x = 0;
+        int16_t y = 0;
+
+        for (size_t iQueue = 0; iQueue < samples.Count; iQueue++)
+        {
+            GestureData data = samples[iQueue];
+
+            for (uint8_t channel = 0; channel < GestureData::Count; channel++)
+            {
+                sums[channel] += data[channel];
+            }
+            x += GestureRatio(data.Right, data.Left);
+            y += GestureRatio(data.Up, data.Down);
+        }
+
+        uint8_t minIndex = 0;
+        for (uint8_t channel = 1; channel < GestureData::Count; channel++)
+        {
+            if (sums[channel] < sums[minIndex])
+            {
+                minIndex = channel;
+            }
+        }
+
+        int16_t count = static_cast<int16_t>(samples.Count);
+        Values[featureMin] = minIndex;
+        Values[featureX] = x / count;
+        Values[featureY] = y / count;
+    }
+};
+
+// A node of a generated decision tree, kept in PROGMEM.
+// Inner nodes go to Left when features[Feature] <= Threshold else Right,
+// both are node indexes.  Leaf nodes have Feature == GestureTreeLeaf and
+// the GestureVector in Left.
+//
+constexpr uint8_t GestureTreeLeaf = 0xff;
+
+struct GestureTreeNode
+{
+    uint8_t Feature;
+    int16_t Threshold;
+    uint8_t Left;
+    uint8_t Right;
+};
+
+} // namespace
@@ -0,0 +1,207 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+struct GestureOperatingPoint
+{
+    GestureGain Gain;
+    LedDriveCurrent LedDrive;
+    uint8_t PulseCount;
+};
+
+// operating points ordered by increasing signal strength,
+// roughly doubling gain * drive * pulses each step
+const GestureOperatingPoint GestureOperatingPoints[] =
+{
+    { GestureGain_1x, LedDriveCurrent_25mA, 4 },
+    { GestureGain_1x, LedDriveCurrent_50mA, 4 },
+    { GestureGain_1x, LedDriveCurrent_100mA, 4 },
+    { GestureGain_1x, LedDriveCurrent_100mA, 8 },
+    { GestureGain_2x, LedDriveCurrent_100mA, 8 },
+    { GestureGain_2x, LedDriveCurrent_150mA, 8 },
+    { GestureGain_2x, LedDriveCurrent_300mA, 8 }, // library defaults
+    { GestureGain_4x, LedDriveCurrent_300mA, 8 },
+    { GestureGain_4x, LedDriveCurrent_300mA, 16 },
+    { GestureGain_8x, LedDriveCurrent_300mA, 16 },
+    { GestureGain_8x, LedDriveCurrent_300mA, 32 },
+};
+
+constexpr uint8_t GestureOperatingPointCount = countof(GestureOperatingPoints);
+constexpr uint8_t GestureOperatingPointDefault = 6;
+
+// Closed loop control of the gesture gain, LED drive and pulse count.
+//
+// After each gesture the signal statistics from the engine are checked.
+// When clipping or a weak signal persists across gestures the operating
+// point is stepped down or up.  The best operating point is the one that
+// produced a run of good gestures; persist it (EEPROM) and give it to
+// SetOperatingPoint() at startup to skip the learning for an installation.
+//
+// NOTE: LED boost is shared with proximity, so proximity sensitivity will
+// change with the operating point.
+//
+template<class T_ADPS, class T_GESTURE_ENGINE> class GestureGainControl
+{
+public:
+    GestureGainControl(uint8_t weakPeak = 64,
+            uint8_t persistence = 2,
+            ProximityPulseLength pulseLength = ProximityPulseLength_8us) :
+        c_WeakPeak(weakPeak),
+        c_Persistence(persistence),
+        c_PulseLength(pulseLength),
+        _operatingPoint(GestureOperatingPointDefault),
+        _bestOperatingPoint(GestureOperatingPointDefault),
+        _gestureCount(0),
+        _saturatedStreak(0),
+        _weakStreak(0),
+        _goodStreak(0)
+    {
+    }
+
+    void SetOperatingPoint(T_ADPS& adps, uint8_t operatingPoint)
+    {
+        if (operatingPoint >= GestureOperatingPointCount)
+        {
+            operatingPoint = GestureOperatingPointCount - 1;
+        }
+        apply(adps, operatingPoint);
+        if (adps.LastError() == WIRE_UTIL::Error_None)
+        {
+            _bestOperatingPoint = operatingPoint;
+        }
+    }
+
+    uint8_t OperatingPoint() const
+    {
+        return _operatingPoint;
+    }
+
+    uint8_t BestOperatingPoint() const
+    {
+        return _bestOperatingPoint;
+    }
+
+    // call after the engine has processed, ideally each loop;
+    // the device is only touched when a gesture has ended
+    void Update(T_ADPS& adps, const T_GESTURE_ENGINE& engine)
+    {
+        if (engine.GestureCount() == _gestureCount)
+        {
+            return;
+        }
+        _gestureCount = engine.GestureCount();
+
+        const GestureSignalStats& stats = engine.LastGestureSignalStats();
+        if (stats.SampleCount == 0)
+        {
+            return;
+        }
+
+        // a quarter of the samples clipped ruins the classification,
+        // the analog saturation flag also catches clipping in the AFE
+        bool saturated = (stats.SaturatedCount * 4 >= stats.SampleCount);
+        if (!saturated)
+        {
+            Status status = adps.GetStatus();
+            if (adps.LastError() == WIRE_UTIL::Error_None)
+            {
+                saturated = status.IsProximityGestureSaturated();
+            }
+        }
+        // PGSAT is sticky, clear it so it only describes the next gesture
+        adps.LatchInterrupt(Feature_Proximity);
+        bool weak = (stats.Peak < c_WeakPeak);
+
+        if (saturated)
+        {
+            _weakStreak = 0;
+            _goodStreak = 0;
+            if (++_saturatedStreak >= c_Persistence && _operatingPoint > 0)
+            {
+                apply(adps, _operatingPoint - 1);
+            }
+        }
+        else if (weak)
+        {
+            _saturatedStreak = 0;
+            _goodStreak = 0;
+            if (++_weakStreak >= c_Persistence && _operatingPoint < GestureOperatingPointCount - 1)
+            {
+                apply(adps, _operatingPoint + 1);
+            }
+        }
+        else
+        {
+            _saturatedStreak = 0;
+            _weakStreak = 0;
+            if (_goodStreak < 0xff && ++_goodStreak >= c_Persistence * 2)
+            {
+                _bestOperatingPoint = _operatingPoint;
+            }
+        }
+    }
+
+protected:
+    const uint8_t c_WeakPeak;
+    const uint8_t c_Persistence;
+    const ProximityPulseLength c_PulseLength;
+
+    uint8_t _operatingPoint;
+    uint8_t _bestOperatingPoint;
+    uint32_t _gestureCount;
+    uint8_t _saturatedStreak;
+    uint8_t _weakStreak;
+    uint8_t _goodStreak;
+
+    void apply(T_ADPS& adps, uint8_t operatingPoint)
+    {
+        const GestureOperatingPoint& point = GestureOperatingPoints[operatingPoint];
+
+        _saturatedStreak = 0;
+        _weakStreak = 0;
+        _goodStreak = 0;
+
+        adps.SetGestureGainAndDrive(point.Gain, point.LedDrive);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.SetGesturePulseConfig(point.PulseCount, c_PulseLength);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        _operatingPoint = operatingPoint;
+    }
+};
+
+} // namespace
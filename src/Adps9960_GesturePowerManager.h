@@ -0,0 +1,246 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+#include "Gesture_types.h"
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+// Keeps the gesture engine (and its boosted LED drive) off while nothing
+// is near the sensor.  Only slow proximity cycles run until the approach
+// threshold interrupt asserts, then the gesture engine is enabled with fast
+// timing until the gesture has exited and the hold time has passed.
+//
+// The LED boost is shared with proximity, so it is dropped to 100% in the
+// low power mode and the gesture boost in use on entry is restored on wake.
+//
+// The proximity interrupt is always enabled in the low power mode as the
+// PINT status bit is used to detect the approach even when the INT pin is
+// not connected.  Call Process() from the interrupt flag or from loop().
+// All timing uses the engine's clock policy.
+//
+template<class T_ADPS, class T_GESTURE_ENGINE> class GesturePowerManager
+{
+public:
+    typedef typename T_GESTURE_ENGINE::ClockType ClockType;
+
+    GesturePowerManager(uint8_t approachThreshold = 40,
+            float msIdleWaitTime = 250.0f,
+            float msGestureWaitTime = MS_ADC_TIME_QUOTUM,
+            uint32_t exitHoldMs = 500) :
+        c_ApproachThreshold(approachThreshold),
+        c_IdleWaitTimeMs(msIdleWaitTime),
+        c_GestureWaitTimeMs(msGestureWaitTime),
+        c_ExitHold(ADPS_UTIL::UsToTicks<ClockType>(exitHoldMs * 1000)),
+        _gestureMode(false),
+        _gestureInt(false),
+        _firstSampleSeen(false),
+        _gestureLedBoost(LedDriveCurrent_GestureDefault),
+        _wakeTime(0),
+        _lastActiveTime(0),
+        _lastWakeLatencyUs(0),
+        _maxWakeLatencyUs(0),
+        _wakeCount(0)
+    {
+    }
+
+    // enter the low power proximity only mode
+    // gestureInt enables the gesture interrupt while in gesture mode
+    void Begin(T_ADPS& adps, bool gestureInt = false)
+    {
+        _gestureInt = gestureInt;
+        // as if leaving gesture mode, so the configured gesture boost is kept
+        _gestureMode = true;
+        enterLowPower(adps);
+    }
+
+    void Process(T_ADPS& adps,
+            T_GESTURE_ENGINE& engine,
+            GestureCallback callback)
+    {
+        uint32_t now = engine.Clock().Now();
+
+        if (!_gestureMode)
+        {
+            Status status = adps.GetStatus();
+            if (adps.LastError() == WIRE_UTIL::Error_None &&
+                status.IsProximityIntAsserted())
+            {
+                enterGestureMode(adps, now);
+            }
+            return;
+        }
+
+        uint8_t drained = engine.Process(adps, callback);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        if (drained && !_firstSampleSeen)
+        {
+            _firstSampleSeen = true;
+            _lastWakeLatencyUs = ADPS_UTIL::TicksToUs<ClockType>(now - _wakeTime);
+            if (_lastWakeLatencyUs > _maxWakeLatencyUs)
+            {
+                _maxWakeLatencyUs = _lastWakeLatencyUs;
+            }
+        }
+
+        if (engine.IsActive())
+        {
+            _lastActiveTime = now;
+        }
+        else if ((now - _lastActiveTime) > c_ExitHold)
+        {
+            enterLowPower(adps);
+        }
+    }
+
+    bool IsGestureMode() const
+    {
+        return _gestureMode;
+    }
+
+    // time from the approach being detected to the first gesture
+    // FIFO sample being read, including restoring the gesture config,
+    // limited by how often Process is called
+    uint32_t LastWakeLatencyUs() const
+    {
+        return _lastWakeLatencyUs;
+    }
+
+    uint32_t MaxWakeLatencyUs() const
+    {
+        return _maxWakeLatencyUs;
+    }
+
+    uint32_t LastWakeLatencyMs() const
+    {
+        return _lastWakeLatencyUs / 1000;
+    }
+
+    uint32_t MaxWakeLatencyMs() const
+    {
+        return _maxWakeLatencyUs / 1000;
+    }
+
+    uint32_t WakeCount() const
+    {
+        return _wakeCount;
+    }
+
+protected:
+    const uint8_t c_ApproachThreshold;
+    const float c_IdleWaitTimeMs;
+    const float c_GestureWaitTimeMs;
+    const uint32_t c_ExitHold; // ticks
+
+    bool _gestureMode;
+    bool _gestureInt;
+    bool _firstSampleSeen;
+    LedDriveCurrent _gestureLedBoost;
+    uint32_t _wakeTime;
+    uint32_t _lastActiveTime;
+    uint32_t _lastWakeLatencyUs;
+    uint32_t _maxWakeLatencyUs;
+    uint32_t _wakeCount;
+
+    void enterLowPower(T_ADPS& adps)
+    {
+        if (_gestureMode)
+        {
+            // keep the boost the gesture config (or gain control) chose
+            LedDriveCurrent boost = adps.GetLedBoost();
+            if (adps.LastError() != WIRE_UTIL::Error_None)
+            {
+                return;
+            }
+            _gestureLedBoost = boost;
+        }
+        _gestureMode = false;
+
+        adps.SetLedBoost(LedDriveCurrent_100mA);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.SetWaitTime(c_IdleWaitTimeMs);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.SetProximityIntThresholds(0, c_ApproachThreshold);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.Start(Feature_Proximity, Feature_Proximity);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.LatchInterrupt(Feature_Proximity);
+    }
+
+    void enterGestureMode(T_ADPS& adps, uint32_t now)
+    {
+        adps.LatchInterrupt(Feature_Proximity);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.SetLedBoost(_gestureLedBoost);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.SetWaitTime(c_GestureWaitTimeMs);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+        adps.Start(Feature_Gesture, _gestureInt ? Feature_Gesture : Feature_None);
+        if (adps.LastError() != WIRE_UTIL::Error_None)
+        {
+            return;
+        }
+
+        _gestureMode = true;
+        _firstSampleSeen = false;
+        _wakeTime = now;
+        _lastActiveTime = now;
+        _wakeCount++;
+    }
+};
+
+} // namespace
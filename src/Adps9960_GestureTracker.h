@@ -0,0 +1,172 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "AdpsClock.h"
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+// position is normalized to -1024 to 1024 (left to right, down to up)
+// and velocity is in those units per second
+struct HandPosition
+{
+    HandPosition() :
+        X(0),
+        Y(0),
+        VelocityX(0),
+        VelocityY(0),
+        Timestamp(0)
+    {
+    }
+
+    int16_t X;
+    int16_t Y;
+    int32_t VelocityX;
+    int32_t VelocityY;
+    uint32_t Timestamp;
+};
+
+typedef void(*HandPositionCallback)(const HandPosition& position);
+
+// Streams a continuous hand position and velocity from the gesture
+// samples, for sliders and similar controls that can't wait for a
+// gesture to finish.  Feed it from GestureEngine::SetSampleCallback.
+//
+// All math is fixed point with a constant cost per sample.  The position
+// is smoothed by an exponential moving average of 1/(2^smoothingShift).
+//
+template<class T_CLOCK = ADPS_UTIL::ClockMillis> class GestureTracker
+{
+public:
+    static constexpr int16_t PositionScale = 1024;
+
+    GestureTracker(uint8_t smoothingShift = 2, uint16_t minSignal = 40) :
+        c_SmoothingShift(smoothingShift),
+        c_MinSignal(minSignal),
+        _callback(NULL),
+        _tracking(false),
+        _xAccum(0),
+        _yAccum(0),
+        _vxAccum(0),
+        _vyAccum(0)
+    {
+    }
+
+    void SetCallback(HandPositionCallback callback)
+    {
+        _callback = callback;
+    }
+
+    // returns true if a hand is present and the position was updated
+    bool Update(const GestureData& data, uint32_t timestamp)
+    {
+        uint16_t sumX = static_cast<uint16_t>(data.Right) + data.Left;
+        uint16_t sumY = static_cast<uint16_t>(data.Up) + data.Down;
+
+        if (sumX < c_MinSignal || sumY < c_MinSignal)
+        {
+            _tracking = false;
+            return false;
+        }
+
+        int32_t x = (static_cast<int32_t>(data.Right) - data.Left) * PositionScale / sumX;
+        int32_t y = (static_cast<int32_t>(data.Up) - data.Down) * PositionScale / sumY;
+
+        // accumulators keep AccumShift extra fractional bits
+        x *= (1 << AccumShift);
+        y *= (1 << AccumShift);
+
+        if (!_tracking)
+        {
+            _tracking = true;
+            _xAccum = x;
+            _yAccum = y;
+            _vxAccum = 0;
+            _vyAccum = 0;
+        }
+        else
+        {
+            int32_t lastX = _xAccum;
+            int32_t lastY = _yAccum;
+
+            _xAccum += (x - _xAccum) >> c_SmoothingShift;
+            _yAccum += (y - _yAccum) >> c_SmoothingShift;
+
+            uint32_t deltaUs = ADPS_UTIL::TicksToUs<T_CLOCK>(timestamp - _position.Timestamp);
+            if (deltaUs != 0)
+            {
+                // the fractional bits are kept through the divide, dx of
+                // 2048 << AccumShift times 1000000 needs the 64 bit product
+                int32_t vx = static_cast<int32_t>(static_cast<int64_t>(_xAccum - lastX) * 1000000 / deltaUs >> AccumShift);
+                int32_t vy = static_cast<int32_t>(static_cast<int64_t>(_yAccum - lastY) * 1000000 / deltaUs >> AccumShift);
+
+                _vxAccum += (vx - _vxAccum) >> c_SmoothingShift;
+                _vyAccum += (vy - _vyAccum) >> c_SmoothingShift;
+            }
+        }
+
+        _position.X = static_cast<int16_t>(_xAccum >> AccumShift);
+        _position.Y = static_cast<int16_t>(_yAccum >> AccumShift);
+        _position.VelocityX = _vxAccum;
+        _position.VelocityY = _vyAccum;
+        _position.Timestamp = timestamp;
+
+        if (_callback)
+        {
+            _callback(_position);
+        }
+        return true;
+    }
+
+    bool IsTracking() const
+    {
+        return _tracking;
+    }
+
+    const HandPosition& Position() const
+    {
+        return _position;
+    }
+
+protected:
+    static constexpr uint8_t AccumShift = 4;
+
+    const uint8_t c_SmoothingShift;
+    const uint16_t c_MinSignal;
+
+    HandPositionCallback _callback;
+    bool _tracking;
+    int32_t _xAccum;
+    int32_t _yAccum;
+    int32_t _vxAccum;
+    int32_t _vyAccum;
+    HandPosition _position;
+};
+
+} // namespace
@@ -0,0 +1,104 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "AdpsUtil.h"
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+// Sensor mounting orientation for the Adps9960 T_ORIENTATION
+//
+// Each parameter is the physical photodiode (GestureDirection) that is
+// read for that logical direction.  The driver remaps gesture data, gesture
+// offsets and photodiode masks at compile time, so everything above it
+// (engine, classifiers, tracker, callbacks) works in the logical frame.
+//
+// Rotations are the clockwise rotation of the sensor as mounted, mirrored
+// variants have left and right swapped after the rotation.
+//
+template<GestureDirection V_UP,
+    GestureDirection V_DOWN,
+    GestureDirection V_LEFT,
+    GestureDirection V_RIGHT> struct SensorOrientation
+{
+    static constexpr GestureDirection PhysicalUp = V_UP;
+    static constexpr GestureDirection PhysicalDown = V_DOWN;
+    static constexpr GestureDirection PhysicalLeft = V_LEFT;
+    static constexpr GestureDirection PhysicalRight = V_RIGHT;
+
+    static GestureData ToLogical(const GestureData& physical)
+    {
+        return GestureData(physical[V_UP],
+            physical[V_DOWN],
+            physical[V_LEFT],
+            physical[V_RIGHT]);
+    }
+
+    // logical PhotoDiode flags to the physical flags
+    static constexpr uint8_t ToPhysical(uint8_t photoDiodes)
+    {
+        return ((photoDiodes & PhotoDiode_U) ? photoDiodeFlag(V_UP) : 0) |
+            ((photoDiodes & PhotoDiode_D) ? photoDiodeFlag(V_DOWN) : 0) |
+            ((photoDiodes & PhotoDiode_L) ? photoDiodeFlag(V_LEFT) : 0) |
+            ((photoDiodes & PhotoDiode_R) ? photoDiodeFlag(V_RIGHT) : 0);
+    }
+
+    // the proximity offsets only exist for the UR and DL pairs, so they can
+    // only be remapped when the logical pairs land on those physical pairs
+    static constexpr bool IsProximityOffsetMappable()
+    {
+        return (ToPhysical(PhotoDiode_U | PhotoDiode_R) == (PhotoDiode_U | PhotoDiode_R)) ||
+            (ToPhysical(PhotoDiode_U | PhotoDiode_R) == (PhotoDiode_D | PhotoDiode_L));
+    }
+
+    static constexpr bool IsProximityOffsetSwapped()
+    {
+        return (ToPhysical(PhotoDiode_U | PhotoDiode_R) == (PhotoDiode_D | PhotoDiode_L));
+    }
+
+private:
+    static constexpr uint8_t photoDiodeFlag(GestureDirection direction)
+    {
+        return (direction == GestureDirection_Up) ? PhotoDiode_U :
+            (direction == GestureDirection_Down) ? PhotoDiode_D :
+            (direction == GestureDirection_Left) ? PhotoDiode_L : PhotoDiode_R;
+    }
+};
+
+typedef SensorOrientation<GestureDirection_Up, GestureDirection_Down, GestureDirection_Left, GestureDirection_Right> SensorOrientation_0;
+typedef SensorOrientation<GestureDirection_Left, GestureDirection_Right, GestureDirection_Down, GestureDirection_Up> SensorOrientation_90;
+typedef SensorOrientation<GestureDirection_Down, GestureDirection_Up, GestureDirection_Right, GestureDirection_Left> SensorOrientation_180;
+typedef SensorOrientation<GestureDirection_Right, GestureDirection_Left, GestureDirection_Up, GestureDirection_Down> SensorOrientation_270;
+
+typedef SensorOrientation<GestureDirection_Up, GestureDirection_Down, GestureDirection_Right, GestureDirection_Left> SensorOrientation_Mirrored_0;
+typedef SensorOrientation<GestureDirection_Left, GestureDirection_Right, GestureDirection_Up, GestureDirection_Down> SensorOrientation_Mirrored_90;
+typedef SensorOrientation<GestureDirection_Down, GestureDirection_Up, GestureDirection_Left, GestureDirection_Right> SensorOrientation_Mirrored_180;
+typedef SensorOrientation<GestureDirection_Right, GestureDirection_Left, GestureDirection_Down, GestureDirection_Up> SensorOrientation_Mirrored_270;
+
+} // namespace
@@ -0,0 +1,121 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "Adps9960_types.h"
+
+namespace ADPS9960
+{
+
+// Device timing estimates derived from the datasheet
+// all results are in microseconds and usable at compile time
+//
+// NOTE: the datasheet only gives typical values, the pulse phase overhead is
+// an approximation; runtime code should refine these from observed data
+//
+
+constexpr uint8_t GESTURE_FIFO_DEPTH = 32;
+constexpr uint32_t US_ADC_TIME_QUOTUM = 2780;
+constexpr uint32_t US_PULSE_PHASE_OVERHEAD = 700;
+
+constexpr uint32_t GestureWaitTimeToUs(GestureWaitTime waitTime)
+{
+    return (waitTime == GestureWaitTime_0ms) ? 0 :
+        (waitTime == GestureWaitTime_2_8ms) ? 2800 :
+        (waitTime == GestureWaitTime_5_6ms) ? 5600 :
+        (waitTime == GestureWaitTime_8_4ms) ? 8400 :
+        (waitTime == GestureWaitTime_14ms) ? 14000 :
+        (waitTime == GestureWaitTime_22_4ms) ? 22400 :
+        (waitTime == GestureWaitTime_30_8ms) ? 30800 :
+        39200;
+}
+
+constexpr uint8_t GestureFifoThresholdToLevel(GestureFifoThreshold threshold)
+{
+    return (threshold == GestureFifoThreshold_1) ? 1 :
+        (threshold == GestureFifoThreshold_4) ? 4 :
+        (threshold == GestureFifoThreshold_8) ? 8 :
+        16;
+}
+
+constexpr uint32_t PulseLengthToUs(ProximityPulseLength length)
+{
+    return static_cast<uint32_t>(4) << length;
+}
+
+// the time of the LED pulse phase, pulses are an on and off period
+// and gesture mode pulses the UD and then the LR photodiode pairs
+//
+constexpr uint32_t ProximityPulsePhaseUs(uint8_t count, ProximityPulseLength length)
+{
+    return US_PULSE_PHASE_OVERHEAD + static_cast<uint32_t>(count) * PulseLengthToUs(length) * 2;
+}
+
+constexpr uint32_t GesturePulsePhaseUs(uint8_t count, ProximityPulseLength length)
+{
+    return US_PULSE_PHASE_OVERHEAD + static_cast<uint32_t>(count) * PulseLengthToUs(length) * 4;
+}
+
+// ATIME and WTIME register values, WLONG multiplies the wait by 12
+//
+constexpr uint32_t TimeRegToUs(uint8_t time)
+{
+    return (256 - static_cast<uint32_t>(time)) * US_ADC_TIME_QUOTUM;
+}
+
+constexpr uint32_t WaitTimeRegToUs(uint8_t wtime, bool waitLong)
+{
+    return TimeRegToUs(wtime) * (waitLong ? 12 : 1);
+}
+
+// one proximity/ALS cycle, the proximity pulses then the wait and then
+// the ALS integration, each only when enabled
+//
+constexpr uint32_t DeviceCycleUs(bool proximity,
+    bool als,
+    bool wait,
+    uint8_t atime,
+    uint8_t wtime,
+    bool waitLong,
+    uint8_t pulseCount = 8,
+    ProximityPulseLength pulseLength = ProximityPulseLength_8us)
+{
+    return (proximity ? ProximityPulsePhaseUs(pulseCount, pulseLength) : 0) +
+        (wait ? WaitTimeRegToUs(wtime, waitLong) : 0) +
+        (als ? TimeRegToUs(atime) : 0);
+}
+
+// the time between samples entering the gesture FIFO
+//
+constexpr uint32_t GestureCycleUs(GestureWaitTime waitTime,
+    uint8_t pulseCount = 8,
+    ProximityPulseLength pulseLength = ProximityPulseLength_8us)
+{
+    return GesturePulsePhaseUs(pulseCount, pulseLength) + GestureWaitTimeToUs(waitTime);
+}
+
+} // namespace
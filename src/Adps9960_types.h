@@ -185,6 +185,23 @@ constexpr float MS_ADC_TIME_QUOTUM = 2.78f;
 constexpr uint8_t ALS_ADC_TIME_DEFAULT = 0xf6; // 27.8ms
 constexpr float MS_ALS_ADC_TIME_DEFAULT = MS_ADC_TIME_QUOTUM * (256 - ALS_ADC_TIME_DEFAULT);
 
+// register bank 0x80 - 0xAF, see Adps9960::ReadRegisterBank
+constexpr uint8_t REGISTER_BANK_FIRST = 0x80;
+constexpr uint8_t REGISTER_BANK_SIZE = 48;
+constexpr uint8_t REGISTER_BANK_DIFF_SIZE = (REGISTER_BANK_SIZE + 7) / 8;
+
+// bits of each bank register that are configuration and can be restored,
+// zero for read only and reserved registers
+const uint8_t RegisterBankWritable[REGISTER_BANK_SIZE] PROGMEM =
+{
+    0x7f, 0xff, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, // 0x80 ENABLE, ATIME, -, WTIME, AILTL, AILTH, AIHTL, AIHTH
+    0x00, 0xff, 0x00, 0xff, 0xff, 0x62, 0xff, 0xcf, // 0x88 -, PILT, -, PIHT, PERS, CONFIG1, PPULSE, CONTROL
+    0xf1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x90 CONFIG2, -, ID, STATUS, CDATAL, CDATAH, RDATAL, RDATAH
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0x3f, // 0x98 GDATAL, GDATAH, BDATAL, BDATAH, PDATA, POFFSET_UR, POFFSET_DL, CONFIG3
+    0xef, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff, 0xff, // 0xA0 GPENTH, GEXTH, GCONF1, GCONF2, GOFFSET_U, GOFFSET_D, GPULSE, GOFFSET_L
+    0x00, 0xff, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, // 0xA8 -, GOFFSET_R, GCONF3, GCONF4 (not GFIFO_CLR), -, -, GFLVL, GSTATUS
+};
+
 struct Status
 {
     Status(uint8_t status = 0) :
@@ -231,7 +248,7 @@ private:
     uint8_t _status;
 
     // STATUS Register Bits
-    static constexpr uint8_t STATUS_CPSAT = 6;
+    static constexpr uint8_t STATUS_CPSAT = 7;
     static constexpr uint8_t STATUS_PGSAT = 6;
 
     static constexpr uint8_t STATUS_PINT = 5;
@@ -322,6 +339,67 @@ private:
     }
 };
 
+// the registers needed to check the sensor is alive alongside the data,
+// see GetSnapshot(), read as one burst of ENABLE through PDATA
+constexpr uint8_t SNAPSHOT_FIRST = 0x80;
+constexpr uint8_t SNAPSHOT_SIZE = 0x9C - SNAPSHOT_FIRST + 1;
+
+struct Snapshot
+{
+    Snapshot() :
+        Enable(0),
+        Id(0),
+        Proximity(0)
+    {
+    }
+
+    bool IsPoweredOn() const
+    {
+        return (Enable & _BV(ENABLE_PON));
+    }
+
+    // true if ALS or proximity are enabled, so new data is expected each cycle
+    bool IsDataExpected() const
+    {
+        return (Enable & (_BV(ENABLE_AEN) | _BV(ENABLE_PEN)));
+    }
+
+    // true if an enabled feature completed a cycle since the last read
+    bool HasNewData() const
+    {
+        return ((Enable & _BV(ENABLE_AEN)) && Status.IsAlsDataValid()) ||
+            ((Enable & _BV(ENABLE_PEN)) && Status.IsProximityDataValid());
+    }
+
+    // decodes the SNAPSHOT_SIZE registers read from SNAPSHOT_FIRST
+    static Snapshot Decode(const uint8_t* regs)
+    {
+        Snapshot result;
+        const uint8_t* als = regs + (0x94 - SNAPSHOT_FIRST);
+
+        result.Enable = regs[0];
+        result.Id = regs[0x92 - SNAPSHOT_FIRST];
+        result.Status = ADPS9960::Status(regs[0x93 - SNAPSHOT_FIRST]);
+        result.Als = AlsData(als[0] | (als[1] << 8),
+            als[2] | (als[3] << 8),
+            als[4] | (als[5] << 8),
+            als[6] | (als[7] << 8));
+        result.Proximity = regs[0x9C - SNAPSHOT_FIRST];
+        return result;
+    }
+
+    uint8_t Enable;
+    uint8_t Id;
+    ADPS9960::Status Status;
+    ADPS9960::AlsData Als;
+    uint8_t Proximity;
+
+private:
+    // ENABLE Register Bits
+    static constexpr uint8_t ENABLE_PEN = 2;
+    static constexpr uint8_t ENABLE_AEN = 1;
+    static constexpr uint8_t ENABLE_PON = 0;
+};
 
 struct MinMaxGestureValues
 {
@@ -395,4 +473,50 @@ struct GestureData
     static constexpr size_t Count = 4; // elements in []
 };
 
+// timestamp is the estimated capture time in the gesture engine clock ticks
+typedef void(*GestureSampleCallback)(const GestureData& data, uint32_t timestamp);
+
+// signal quality of the samples captured during a gesture
+struct GestureSignalStats
+{
+    GestureSignalStats() :
+        SampleCount(0),
+        SaturatedCount(0),
+        Peak(0)
+    {
+    }
+
+    void Add(const GestureData& data)
+    {
+        bool saturated = false;
+
+        for (uint8_t index = 0; index < GestureData::Count; index++)
+        {
+            uint8_t value = data[index];
+
+            if (value > Peak)
+            {
+                Peak = value;
+            }
+            if (value == 255)
+            {
+                saturated = true;
+            }
+        }
+
+        if (SampleCount < 0xffff)
+        {
+            SampleCount++;
+            if (saturated)
+            {
+                SaturatedCount++;
+            }
+        }
+    }
+
+    uint16_t SampleCount;
+    uint16_t SaturatedCount; // samples with at least one channel clipped
+    uint8_t Peak;
+};
+
 } // namespace
\ No newline at end of file
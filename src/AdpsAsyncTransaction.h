@@ -0,0 +1,308 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+
+namespace WIRE_UTIL
+{
+    // called when a queued transaction finishes, from AsyncTransactionQueue::Service()
+    typedef void(*AsyncCompletion)(void* context, uint8_t error);
+
+    enum AsyncFlag
+    {
+        AsyncFlag_None = 0,
+        AsyncFlag_Read = 0x01,
+        AsyncFlag_FixedRegister = 0x02, // a FIFO, chunks don't advance the register
+        AsyncFlag_Reserved = 0x04, // takes the descriptor set aside by Reserve()
+    };
+
+    // writes of up to this many bytes are copied into the descriptor
+    constexpr uint8_t AsyncInlineLength = 4;
+
+    struct AsyncTransaction
+    {
+        uint8_t Address;
+        uint8_t Register; // or command byte
+        uint8_t Flags;
+        uint8_t Length;
+        uint8_t Offset; // progress through Buffer
+        uint8_t* Buffer;
+        uint8_t Inline[AsyncInlineLength];
+        AsyncCompletion Completion;
+        void* Context;
+
+        uint8_t* Data()
+        {
+            return Buffer ? Buffer : Inline;
+        }
+    };
+
+    // Async wire adapters move one chunk (at most BufferLength bytes,
+    // including the register on writes) without waiting and provide
+    //    void Start(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t count, bool read)
+    //        a register write then count bytes read, or the register and count bytes written
+    //    bool IsBusy() - until the chunk completes
+    //    uint8_t Result() - the WIRE_UTIL::Error of the completed chunk
+    //
+    // Platforms with interrupt or DMA driven I2C (ESP-IDF, STM32 HAL) start
+    // the transfer in Start() and set the result from their completion
+    // callback.  AsyncWireBlocking adapts any Wire, each chunk still blocks
+    // but only for one chunk per Service() step.
+    //
+    template<class T_WIRE_METHOD> class AsyncWireBlocking
+    {
+    public:
+        AsyncWireBlocking(T_WIRE_METHOD& wire) :
+            _wire(wire),
+            _result(Error_None)
+        {
+        }
+
+        void Start(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t count, bool read)
+        {
+            _wire.beginTransmission(address);
+            _wire.write(reg);
+            if (!read)
+            {
+                for (uint8_t index = 0; index < count; index++)
+                {
+                    _wire.write(buffer[index]);
+                }
+            }
+            _result = _wire.endTransmission();
+
+            if (read && _result == Error_None)
+            {
+                size_t bytesRead = _wire.requestFrom(address, count);
+                if (count != bytesRead)
+                {
+                    _result = Error_Unspecific;
+                }
+                else
+                {
+                    for (uint8_t index = 0; index < count; index++)
+                    {
+                        buffer[index] = _wire.read();
+                    }
+                }
+            }
+        }
+
+        bool IsBusy() const
+        {
+            return false;
+        }
+
+        uint8_t Result() const
+        {
+            return _result;
+        }
+
+    private:
+        T_WIRE_METHOD& _wire;
+        uint8_t _result;
+    };
+
+    // A fixed size queue of transaction descriptors for one bus, advanced
+    // one chunk per Service() call so no call blocks for a whole request.
+    // Call Service() from the loop; with an interrupt driven adapter it can
+    // also be called from its completion callback when the completions
+    // given to Enqueue() are safe there.
+    //
+    // Several devices on the same bus share one queue.  A request that
+    // continues from its completion reserves the descriptor for the next
+    // step up front, so it can't be refused by a queue others have filled.
+    //
+    template<class T_ASYNC_WIRE, uint8_t V_DEPTH = 8> class AsyncTransactionQueue
+    {
+    public:
+        AsyncTransactionQueue(T_ASYNC_WIRE& wire) :
+            _wire(wire),
+            _front(0),
+            _count(0),
+            _reserved(0),
+            _active(false)
+        {
+        }
+
+        // buffer must stay valid until completion, for writes it may be
+        // NULL when data (length <= AsyncInlineLength) is copied instead
+        bool Enqueue(uint8_t address,
+                uint8_t reg,
+                uint8_t flags,
+                uint8_t* buffer,
+                uint8_t length,
+                AsyncCompletion completion,
+                void* context,
+                const uint8_t* data = NULL)
+        {
+            if (!buffer && (length > AsyncInlineLength || !data))
+            {
+                return false;
+            }
+            if (flags & AsyncFlag_Reserved)
+            {
+                if (_reserved == 0)
+                {
+                    return false;
+                }
+                _reserved--;
+            }
+            else if (_count + _reserved >= V_DEPTH)
+            {
+                return false;
+            }
+
+            AsyncTransaction& transaction = _transactions[(_front + _count) % V_DEPTH];
+
+            transaction.Address = address;
+            transaction.Register = reg;
+            transaction.Flags = flags;
+            transaction.Length = length;
+            transaction.Offset = 0;
+            transaction.Buffer = buffer;
+            transaction.Completion = completion;
+            transaction.Context = context;
+            if (!buffer)
+            {
+                for (uint8_t index = 0; index < length; index++)
+                {
+                    transaction.Inline[index] = data[index];
+                }
+            }
+            _count++;
+            return true;
+        }
+
+        // returns true while transactions are pending
+        bool Service()
+        {
+            if (_active)
+            {
+                if (_wire.IsBusy())
+                {
+                    return true;
+                }
+
+                AsyncTransaction& transaction = _transactions[_front];
+                uint8_t error = _wire.Result();
+
+                transaction.Offset += chunkLength(transaction);
+                if (error != Error_None || transaction.Offset >= transaction.Length)
+                {
+                    _active = false;
+                    _front = (_front + 1) % V_DEPTH;
+                    _count--;
+
+                    // may enqueue more, the descriptor is already free
+                    if (transaction.Completion)
+                    {
+                        transaction.Completion(transaction.Context, error);
+                    }
+                    return (_count != 0);
+                }
+                startChunk(transaction);
+                return true;
+            }
+
+            if (_count)
+            {
+                _active = true;
+                startChunk(_transactions[_front]);
+                return true;
+            }
+            return false;
+        }
+
+        // sets a descriptor aside for a later Enqueue() with AsyncFlag_Reserved,
+        // false when the queue is full
+        bool Reserve()
+        {
+            if (_count + _reserved >= V_DEPTH)
+            {
+                return false;
+            }
+            _reserved++;
+            return true;
+        }
+
+        // returns a reserved descriptor that won't be used
+        void Release()
+        {
+            if (_reserved)
+            {
+                _reserved--;
+            }
+        }
+
+        uint8_t PendingCount() const
+        {
+            return _count;
+        }
+
+        bool IsIdle() const
+        {
+            return (_count == 0);
+        }
+
+    private:
+        T_ASYNC_WIRE& _wire;
+        AsyncTransaction _transactions[V_DEPTH];
+        uint8_t _front;
+        uint8_t _count;
+        uint8_t _reserved;
+        bool _active;
+
+        static uint8_t chunkLength(const AsyncTransaction& transaction)
+        {
+            // writes share the buffer with the register
+            uint8_t most = (transaction.Flags & AsyncFlag_Read) ? BufferLength : BufferLength - 1;
+            uint8_t remaining = transaction.Length - transaction.Offset;
+
+            return (remaining > most) ? most : remaining;
+        }
+
+        void startChunk(AsyncTransaction& transaction)
+        {
+            uint8_t reg = transaction.Register;
+
+            if (!(transaction.Flags & AsyncFlag_FixedRegister))
+            {
+                reg += transaction.Offset;
+            }
+            _wire.Start(transaction.Address,
+                reg,
+                transaction.Data() + transaction.Offset,
+                chunkLength(transaction),
+                transaction.Flags & AsyncFlag_Read);
+        }
+    };
+}
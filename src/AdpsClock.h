@@ -0,0 +1,175 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <chrono>
+#endif
+
+namespace ADPS_UTIL
+{
+    // Clock policies provide Now() in ticks and the number of TicksPerMs,
+    // TicksPerMs must be 1 or a multiple of 1000.
+    // Tick values wrap, so only compare differences between two ticks.
+    //
+
+#if defined(ARDUINO)
+    class ClockMillis
+    {
+    public:
+        static constexpr uint32_t TicksPerMs = 1;
+
+        uint32_t Now() const
+        {
+            return millis();
+        }
+    };
+
+    class ClockMicros
+    {
+    public:
+        static constexpr uint32_t TicksPerMs = 1000;
+
+        uint32_t Now() const
+        {
+            return micros();
+        }
+    };
+#else
+    class ClockMillis
+    {
+    public:
+        static constexpr uint32_t TicksPerMs = 1;
+
+        uint32_t Now() const
+        {
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    };
+
+    class ClockMicros
+    {
+    public:
+        static constexpr uint32_t TicksPerMs = 1000;
+
+        uint32_t Now() const
+        {
+            return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+    };
+#endif
+
+    // a clock that only moves when told to, for trace replay and benchmarks
+    // that need to run faster than real time with exact timing
+    class ClockVirtual
+    {
+    public:
+        static constexpr uint32_t TicksPerMs = 1000;
+
+        ClockVirtual(uint32_t now = 0) :
+            _now(now)
+        {
+        }
+
+        uint32_t Now() const
+        {
+            return _now;
+        }
+
+        void Set(uint32_t now)
+        {
+            _now = now;
+        }
+
+        void Advance(uint32_t ticks)
+        {
+            _now += ticks;
+        }
+
+    private:
+        uint32_t _now;
+    };
+
+    template<class T_CLOCK> constexpr uint32_t MsToTicks(uint32_t ms)
+    {
+        return ms * T_CLOCK::TicksPerMs;
+    }
+
+    template<class T_CLOCK> constexpr uint32_t TicksToMs(uint32_t ticks)
+    {
+        return ticks / T_CLOCK::TicksPerMs;
+    }
+
+    template<class T_CLOCK> constexpr uint32_t UsToTicks(uint32_t us)
+    {
+        return (T_CLOCK::TicksPerMs >= 1000) ?
+            us * (T_CLOCK::TicksPerMs / 1000) :
+            us / (1000 / T_CLOCK::TicksPerMs);
+    }
+
+    template<class T_CLOCK> constexpr uint32_t TicksToUs(uint32_t ticks)
+    {
+        return (T_CLOCK::TicksPerMs >= 1000) ?
+            ticks / (T_CLOCK::TicksPerMs / 1000) :
+            ticks * (1000 / T_CLOCK::TicksPerMs);
+    }
+
+    // a value with the clock ticks it was captured at
+    template<typename T_VALUE> struct Timestamped
+    {
+        Timestamped(T_VALUE value = T_VALUE(), uint32_t timestamp = 0) :
+            Value(value),
+            Timestamp(timestamp)
+        {
+        }
+
+        T_VALUE Value;
+        uint32_t Timestamp;
+    };
+
+    // Estimates when a proximity or ALS value read at readTime was captured.
+    // The integration producing it ended somewhere in the last device cycle,
+    // so the expected capture (mid integration) is half a cycle plus half
+    // the integration time before the read.
+    template<class T_CLOCK> uint32_t EstimateCaptureTime(uint32_t readTime,
+            uint32_t cycleUs,
+            uint32_t integrationUs)
+    {
+        return readTime - UsToTicks<T_CLOCK>(cycleUs / 2 + integrationUs / 2);
+    }
+
+    // true once now has reached or passed deadline, handles wrap around
+    inline bool IsTimeReached(uint32_t now, uint32_t deadline)
+    {
+        return (static_cast<int32_t>(now - deadline) >= 0);
+    }
+}
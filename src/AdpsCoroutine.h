@@ -0,0 +1,712 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#if !defined(ARDUINO) && defined(__cpp_impl_coroutine)
+
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+#include "Gesture_types.h"
+#include "Adps9960_types.h"
+#include "Adps9930_types.h"
+
+namespace ADPS_UTIL
+{
+    // C++20 coroutine API for host services, one EventLoop thread can
+    // multiplex any number of sensors:
+    //
+    //    Task<> watch(AsyncSensor<Adps9960<Wire>>& sensor)
+    //    {
+    //        for (;;)
+    //        {
+    //            auto proximity = co_await sensor.NextProximity();
+    //            ...
+    //        }
+    //    }
+    //
+    //    loop.Spawn(watch(sensor));
+    //    loop.Run();
+    //
+    // Sensors sleep until their predicted data ready time or interrupt
+    // and then read only what was asked for.
+    //
+
+    template<typename T_VALUE> class Task;
+
+    struct TaskPromiseBase
+    {
+        TaskPromiseBase() :
+            Detached(false)
+        {
+        }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            template<typename T_PROMISE> std::coroutine_handle<> await_suspend(std::coroutine_handle<T_PROMISE> handle) noexcept
+            {
+                TaskPromiseBase& promise = handle.promise();
+
+                if (promise.Continuation)
+                {
+                    return promise.Continuation;
+                }
+                if (promise.Detached)
+                {
+                    handle.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept
+            {
+            }
+        };
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return std::suspend_always();
+        }
+
+        FinalAwaiter final_suspend() noexcept
+        {
+            return FinalAwaiter();
+        }
+
+        // the library doesn't throw
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+
+        std::coroutine_handle<> Continuation;
+        bool Detached;
+    };
+
+    template<typename T_VALUE> struct TaskPromise : TaskPromiseBase
+    {
+        Task<T_VALUE> get_return_object();
+
+        void return_value(T_VALUE value)
+        {
+            Value = value;
+        }
+
+        T_VALUE Result()
+        {
+            return Value;
+        }
+
+        T_VALUE Value;
+    };
+
+    template<> struct TaskPromise<void> : TaskPromiseBase
+    {
+        Task<void> get_return_object();
+
+        void return_void()
+        {
+        }
+
+        void Result()
+        {
+        }
+    };
+
+    // a lazily started coroutine that can be co_awaited once,
+    // or given to EventLoop::Spawn() to run on its own
+    template<typename T_VALUE = void> class Task
+    {
+    public:
+        typedef TaskPromise<T_VALUE> promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        explicit Task(Handle handle) :
+            _handle(handle)
+        {
+        }
+
+        Task(Task&& other) noexcept :
+            _handle(other._handle)
+        {
+            other._handle = nullptr;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task()
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+        }
+
+        struct Awaiter
+        {
+            Handle Coroutine;
+
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+            {
+                Coroutine.promise().Continuation = continuation;
+                return Coroutine;
+            }
+
+            T_VALUE await_resume()
+            {
+                return Coroutine.promise().Result();
+            }
+        };
+
+        Awaiter operator co_await() noexcept
+        {
+            return Awaiter{ _handle };
+        }
+
+        // gives up ownership, the coroutine destroys itself when done
+        Handle Detach()
+        {
+            Handle handle = _handle;
+
+            _handle = nullptr;
+            handle.promise().Detached = true;
+            return handle;
+        }
+
+    private:
+        Handle _handle;
+    };
+
+    template<typename T_VALUE> Task<T_VALUE> TaskPromise<T_VALUE>::get_return_object()
+    {
+        return Task<T_VALUE>(std::coroutine_handle<TaskPromise<T_VALUE>>::from_promise(*this));
+    }
+
+    inline Task<void> TaskPromise<void>::get_return_object()
+    {
+        return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+    }
+
+    // Resumes coroutines when their deadline passes or their file
+    // descriptor (an interrupt line event) becomes readable, sleeping
+    // in ppoll() in between.  Single threaded, not thread safe.
+    //
+    class EventLoop
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        // co_await resumes when fd is readable (true) or the deadline passes (false)
+        struct WaitAwaiter
+        {
+            WaitAwaiter(EventLoop& loop, Clock::time_point deadline, int fd) :
+                Loop(loop),
+                Deadline(deadline),
+                Fd(fd),
+                PollIndex(0),
+                Readable(false)
+            {
+            }
+
+            bool await_ready() const
+            {
+                return (Fd < 0 && Deadline <= Clock::now());
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                Coroutine = handle;
+                Loop._waiters.push_back(this);
+            }
+
+            bool await_resume() const
+            {
+                return Readable;
+            }
+
+            EventLoop& Loop;
+            Clock::time_point Deadline;
+            int Fd;
+            size_t PollIndex;
+            bool Readable;
+            std::coroutine_handle<> Coroutine;
+        };
+
+        EventLoop() :
+            _stop(false)
+        {
+        }
+
+        WaitAwaiter SleepUntil(Clock::time_point deadline)
+        {
+            return WaitAwaiter(*this, deadline, -1);
+        }
+
+        WaitAwaiter SleepFor(uint32_t us)
+        {
+            return WaitAwaiter(*this, Clock::now() + std::chrono::microseconds(us), -1);
+        }
+
+        WaitAwaiter WaitReadable(int fd)
+        {
+            return WaitAwaiter(*this, Clock::time_point::max(), fd);
+        }
+
+        WaitAwaiter WaitReadable(int fd, uint32_t timeoutUs)
+        {
+            return WaitAwaiter(*this, Clock::now() + std::chrono::microseconds(timeoutUs), fd);
+        }
+
+        // starts task, it runs until its first wait and then from Run()
+        void Spawn(Task<void>&& task)
+        {
+            task.Detach().resume();
+        }
+
+        // returns when nothing is waiting or Stop() was called
+        void Run()
+        {
+            _stop = false;
+            while (!_stop && !_waiters.empty())
+            {
+                RunOnce();
+            }
+        }
+
+        // waits for and resumes the next ready coroutines
+        void RunOnce()
+        {
+            Clock::time_point deadline = Clock::time_point::max();
+
+            _fds.clear();
+            for (WaitAwaiter* waiter : _waiters)
+            {
+                if (waiter->Deadline < deadline)
+                {
+                    deadline = waiter->Deadline;
+                }
+                if (waiter->Fd >= 0)
+                {
+                    pollfd fd = { waiter->Fd, POLLIN | POLLPRI, 0 };
+
+                    waiter->PollIndex = _fds.size();
+                    _fds.push_back(fd);
+                }
+            }
+
+            timespec timeout;
+            timespec* timeoutPtr = NULL;
+
+            if (deadline != Clock::time_point::max())
+            {
+                Clock::duration remaining = deadline - Clock::now();
+                int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count();
+
+                if (ns < 0)
+                {
+                    ns = 0;
+                }
+                timeout.tv_sec = ns / 1000000000;
+                timeout.tv_nsec = ns % 1000000000;
+                timeoutPtr = &timeout;
+            }
+
+            if (ppoll(_fds.data(), _fds.size(), timeoutPtr, NULL) < 0 && errno != EINTR)
+            {
+                return;
+            }
+
+            // collect first, resuming adds new waiters
+            Clock::time_point now = Clock::now();
+
+            _ready.clear();
+            _remaining.clear();
+            for (WaitAwaiter* waiter : _waiters)
+            {
+                bool ready = (waiter->Deadline <= now);
+
+                if (waiter->Fd >= 0)
+                {
+                    waiter->Readable = (_fds[waiter->PollIndex].revents != 0);
+                    ready = ready || waiter->Readable;
+                }
+
+                if (ready)
+                {
+                    _ready.push_back(waiter->Coroutine);
+                }
+                else
+                {
+                    _remaining.push_back(waiter);
+                }
+            }
+            _waiters.swap(_remaining);
+
+            for (std::coroutine_handle<> coroutine : _ready)
+            {
+                coroutine.resume();
+            }
+        }
+
+        void Stop()
+        {
+            _stop = true;
+        }
+
+        size_t WaitingCount() const
+        {
+            return _waiters.size();
+        }
+
+    private:
+        std::vector<WaitAwaiter*> _waiters;
+        std::vector<WaitAwaiter*> _remaining;
+        std::vector<pollfd> _fds;
+        std::vector<std::coroutine_handle<>> _ready;
+        bool _stop;
+    };
+
+    // the LatchInterrupt() feature enum of a driver
+    template<class T_ADPS, typename T_FEATURE> T_FEATURE AsyncFeatureOf(void (T_ADPS::*)(T_FEATURE));
+
+    // the proximity and ALS values of a driver's feature enum
+    template<typename T_FEATURE> struct AsyncFeatures;
+
+    template<> struct AsyncFeatures<ADPS9960::Feature>
+    {
+        static constexpr ADPS9960::Feature Proximity = ADPS9960::Feature_Proximity;
+        static constexpr ADPS9960::Feature Als = ADPS9960::Feature_AmbiantLightSensor;
+        static constexpr ADPS9960::Feature Both = ADPS9960::Feature_Proximity_Als;
+    };
+
+    template<> struct AsyncFeatures<ADPS9930::Feature>
+    {
+        static constexpr ADPS9930::Feature Proximity = ADPS9930::Feature_Proximity;
+        static constexpr ADPS9930::Feature Als = ADPS9930::Feature_AmbiantLightSensor;
+        static constexpr ADPS9930::Feature Both = ADPS9930::Feature_Proximity_Als;
+    };
+
+    // Awaitable reads of an Adps9960 or Adps9930 on an EventLoop.
+    //
+    // cycleUs is the predicted device cycle (see Adps9960_Timing.h and
+    // the EnergyModel), reads wait until a cycle after the last data.
+    // With an interruptFd (a GPIO line event fd on the INT pin, with the
+    // interrupts and thresholds enabled on the device) reads wait for the
+    // interrupt instead.  STATUS then tells which feature asserted it,
+    // all asserted interrupts are latched and one for the other feature
+    // is kept for its next read.  A sysfs GPIO value fd is always readable
+    // to poll() and is not supported.
+    //
+    // When no data arrives within MaxWaitCycles cycles the read gives up
+    // and LastError() is Error_CommunicationTimeout.
+    //
+    template<class T_ADPS> class AsyncSensor
+    {
+    public:
+        typedef decltype(std::declval<T_ADPS&>().GetProximityData()) ProximityType;
+        typedef decltype(std::declval<T_ADPS&>().GetAlsData()) AlsType;
+        typedef decltype(AsyncFeatureOf(&T_ADPS::LatchInterrupt)) FeatureType;
+
+        static constexpr uint8_t MaxWaitCycles = 4;
+
+        AsyncSensor(EventLoop& loop, T_ADPS& adps, uint32_t cycleUs, int interruptFd = -1) :
+            _loop(loop),
+            _adps(adps),
+            _cycleUs(cycleUs),
+            c_InterruptFd(interruptFd),
+            _lastError(WIRE_UTIL::Error_None),
+            _pendingProximity(false),
+            _pendingAls(false)
+        {
+            _nextProximity = EventLoop::Clock::now();
+            _nextAls = _nextProximity;
+        }
+
+        void SetCycleUs(uint32_t cycleUs)
+        {
+            _cycleUs = cycleUs;
+        }
+
+        uint8_t LastError() const
+        {
+            return _lastError;
+        }
+
+        T_ADPS& Adps()
+        {
+            return _adps;
+        }
+
+        Task<ProximityType> NextProximity()
+        {
+            ProximityType value = 0;
+
+            if (co_await waitData(_nextProximity, AsyncFeatures<FeatureType>::Proximity))
+            {
+                value = _adps.GetProximityData();
+                _lastError = _adps.LastError();
+                _nextProximity = EventLoop::Clock::now() + std::chrono::microseconds(_cycleUs);
+            }
+            co_return value;
+        }
+
+        Task<AlsType> NextAls()
+        {
+            AlsType value;
+
+            if (co_await waitData(_nextAls, AsyncFeatures<FeatureType>::Als))
+            {
+                value = _adps.GetAlsData();
+                _lastError = _adps.LastError();
+                _nextAls = EventLoop::Clock::now() + std::chrono::microseconds(_cycleUs);
+            }
+            co_return value;
+        }
+
+        // completes when the clear (first) channel moves more than delta
+        // from its value at the call
+        Task<AlsType> WaitAlsChange(uint16_t delta)
+        {
+            AlsType reference = co_await NextAls();
+
+            while (_lastError == WIRE_UTIL::Error_None)
+            {
+                AlsType value = co_await NextAls();
+                if (_lastError != WIRE_UTIL::Error_None)
+                {
+                    break;
+                }
+
+                int32_t change = static_cast<int32_t>(alsChannel(value)) - alsChannel(reference);
+                if (change > delta || -change > delta)
+                {
+                    co_return value;
+                }
+            }
+            co_return reference;
+        }
+
+        // Adps9960 only, drives engine with PollAdaptive() and sleeps until
+        // its next deadline, or the interrupt when idle
+        template<class T_ENGINE> Task<ADPS9960::GestureVector> NextGesture(T_ENGINE& engine,
+                uint32_t idleIntervalMs = 100)
+        {
+            bool found = false;
+            ADPS9960::GestureVector gesture = ADPS9960::GestureVector_Unknown;
+
+            for (;;)
+            {
+                engine.PollAdaptive(_adps, [&](ADPS9960::GestureVector result)
+                    {
+                        if (!found)
+                        {
+                            found = true;
+                            gesture = result;
+                        }
+                    }, idleIntervalMs);
+
+                _lastError = _adps.LastError();
+                if (found || _lastError != WIRE_UTIL::Error_None)
+                {
+                    co_return gesture;
+                }
+
+                typedef typename std::remove_reference<decltype(engine.Clock())>::type EngineClock;
+
+                int32_t ticks = static_cast<int32_t>(engine.NextDeadline() - engine.Clock().Now());
+                uint32_t us = (ticks > 0) ? TicksToUs<EngineClock>(ticks) : 0;
+
+                if (c_InterruptFd >= 0)
+                {
+                    if (co_await _loop.WaitReadable(c_InterruptFd, us))
+                    {
+                        drainInterrupt();
+                    }
+                }
+                else
+                {
+                    co_await _loop.SleepFor(us);
+                }
+            }
+        }
+
+    private:
+        EventLoop& _loop;
+        T_ADPS& _adps;
+        uint32_t _cycleUs;
+        const int c_InterruptFd;
+        uint8_t _lastError;
+        EventLoop::Clock::time_point _nextProximity;
+        EventLoop::Clock::time_point _nextAls;
+        bool _pendingProximity; // latched while waiting for the other feature
+        bool _pendingAls;
+
+        static uint16_t alsChannel(const ADPS9960::AlsData& als)
+        {
+            return als.C;
+        }
+
+        static uint16_t alsChannel(const ADPS9930::AlsData& als)
+        {
+            return als.Ch0();
+        }
+
+        // true once the status shows valid data for feature
+        Task<bool> waitData(EventLoop::Clock::time_point predicted, FeatureType feature)
+        {
+            uint32_t pollUs = _cycleUs / 8;
+            uint32_t waitedUs = 0;
+
+            if (pollUs < 500)
+            {
+                pollUs = 500;
+            }
+
+            if (c_InterruptFd >= 0)
+            {
+                bool isProximity = (feature == AsyncFeatures<FeatureType>::Proximity);
+                EventLoop::Clock::time_point deadline = EventLoop::Clock::now() +
+                    std::chrono::microseconds(_cycleUs * MaxWaitCycles);
+
+                for (;;)
+                {
+                    bool& pending = isProximity ? _pendingProximity : _pendingAls;
+                    if (pending)
+                    {
+                        pending = false;
+                        co_return true;
+                    }
+
+                    int64_t remainingUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        deadline - EventLoop::Clock::now()).count();
+                    if (remainingUs <= 0 ||
+                        !co_await _loop.WaitReadable(c_InterruptFd, static_cast<uint32_t>(remainingUs)))
+                    {
+                        _lastError = WIRE_UTIL::Error_CommunicationTimeout;
+                        co_return false;
+                    }
+                    drainInterrupt();
+                    if (!latchAsserted())
+                    {
+                        co_return false;
+                    }
+                }
+            }
+
+            co_await _loop.SleepUntil(predicted);
+            for (;;)
+            {
+                auto status = _adps.GetStatus();
+
+                _lastError = _adps.LastError();
+                if (_lastError != WIRE_UTIL::Error_None)
+                {
+                    co_return false;
+                }
+                if ((feature == AsyncFeatures<FeatureType>::Proximity) ? status.IsProximityDataValid() : status.IsAlsDataValid())
+                {
+                    co_return true;
+                }
+                if (waitedUs >= _cycleUs * MaxWaitCycles)
+                {
+                    _lastError = WIRE_UTIL::Error_CommunicationTimeout;
+                    co_return false;
+                }
+                co_await _loop.SleepFor(pollUs);
+                waitedUs += pollUs;
+            }
+        }
+
+        // reads STATUS and latches the asserted proximity and ALS
+        // interrupts, marking them pending for their readers
+        bool latchAsserted()
+        {
+            auto status = _adps.GetStatus();
+
+            _lastError = _adps.LastError();
+            if (_lastError != WIRE_UTIL::Error_None)
+            {
+                return false;
+            }
+
+            bool proximity = status.IsProximityIntAsserted();
+            bool als = status.IsAlsIntAsserted();
+
+            if (proximity || als)
+            {
+                _adps.LatchInterrupt((proximity && als) ? AsyncFeatures<FeatureType>::Both :
+                    proximity ? AsyncFeatures<FeatureType>::Proximity :
+                    AsyncFeatures<FeatureType>::Als);
+                _lastError = _adps.LastError();
+                if (_lastError != WIRE_UTIL::Error_None)
+                {
+                    return false;
+                }
+                _pendingProximity = _pendingProximity || proximity;
+                _pendingAls = _pendingAls || als;
+            }
+            return true;
+        }
+
+        void drainInterrupt()
+        {
+            uint8_t buffer[64];
+            pollfd fd = { c_InterruptFd, POLLIN | POLLPRI, 0 };
+
+            // line event fds queue one event per edge, read them all
+            while (poll(&fd, 1, 0) > 0 && read(c_InterruptFd, buffer, sizeof(buffer)) > 0)
+            {
+            }
+        }
+    };
+}
+
+#endif
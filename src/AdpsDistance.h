@@ -0,0 +1,428 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsUtil.h"
+#include "AdpsClock.h"
+
+namespace ADPS_UTIL
+{
+    // one calibration point, proximity counts and the distance in mm that
+    // produced them
+    struct DistancePoint
+    {
+        uint16_t Counts;
+        uint16_t Millimetres;
+    };
+
+    // a table is valid with counts rising and distance falling, use it in a
+    // static_assert on constexpr tables
+    constexpr bool IsDistanceTableValid(const DistancePoint* points, uint8_t count)
+    {
+        return (count < 2) ||
+            (points[0].Counts < points[1].Counts &&
+                points[0].Millimetres >= points[1].Millimetres &&
+                IsDistanceTableValid(points + 1, count - 1));
+    }
+
+    // Maps proximity counts to distance through a PROGMEM calibration table
+    // with linear interpolation between points.  Reflected light falls off
+    // with roughly the square of distance and the cover glass crosstalk adds
+    // an offset, so a table measured on the installation with the same pulse
+    // count, pulse length, gain and LED drive it runs with is the only
+    // accurate mapping; changing any of them needs another table.
+    //
+    // Counts outside the table clamp to its first or last distance, a
+    // table needs at least two points.
+    //
+    class DistanceTable
+    {
+    public:
+        // distances from Interpolate() have this many fractional bits
+        static constexpr uint8_t FractionBits = 4;
+
+        DistanceTable(const DistancePoint* points, uint8_t count) :
+            _points(points),
+            _count(count)
+        {
+        }
+
+        uint16_t ToMillimetres(uint16_t counts) const
+        {
+            return (Interpolate(counts) + (1 << (FractionBits - 1))) >> FractionBits;
+        }
+
+        // returns the distance in mm with FractionBits and optionally the
+        // magnitude of the local slope in mm per count with FractionBits,
+        // which scales count noise into distance noise
+        uint16_t Interpolate(uint16_t counts, uint16_t* slope = NULL) const
+        {
+            uint8_t upper = findUpper(counts);
+
+            // beyond the ends the slope of the end segment still applies
+            uint8_t segment = upper;
+            if (segment == 0)
+            {
+                segment = 1;
+            }
+            else if (segment == _count)
+            {
+                segment = _count - 1;
+            }
+
+            uint16_t countsLow = countsAt(segment - 1);
+            uint16_t countsHigh = countsAt(segment);
+            uint32_t mmLow = static_cast<uint32_t>(millimetres(segment - 1)) << FractionBits;
+            uint32_t mmHigh = static_cast<uint32_t>(millimetres(segment)) << FractionBits;
+            uint32_t span = countsHigh - countsLow;
+            uint32_t drop = mmLow - mmHigh;
+
+            if (slope)
+            {
+                *slope = static_cast<uint16_t>((drop + span / 2) / span);
+            }
+
+            if (upper == 0)
+            {
+                return static_cast<uint16_t>(mmLow);
+            }
+            if (upper == _count)
+            {
+                return static_cast<uint16_t>(mmHigh);
+            }
+            return static_cast<uint16_t>(mmLow - (drop * (counts - countsLow) + span / 2) / span);
+        }
+
+        uint16_t MinMillimetres() const
+        {
+            return millimetres(_count - 1);
+        }
+
+        uint16_t MaxMillimetres() const
+        {
+            return millimetres(0);
+        }
+
+    private:
+        const DistancePoint* _points;
+        const uint8_t _count;
+
+        uint16_t countsAt(uint8_t index) const
+        {
+            return pgm_read_word(&_points[index].Counts);
+        }
+
+        uint16_t millimetres(uint8_t index) const
+        {
+            return pgm_read_word(&_points[index].Millimetres);
+        }
+
+        // index of the first point with more counts, binary search
+        uint8_t findUpper(uint16_t counts) const
+        {
+            uint8_t low = 0;
+            uint8_t high = _count;
+
+            while (low < high)
+            {
+                uint8_t middle = (low + high) / 2;
+
+                if (countsAt(middle) <= counts)
+                {
+                    low = middle + 1;
+                }
+                else
+                {
+                    high = middle;
+                }
+            }
+            return low;
+        }
+    };
+
+    // A constant velocity Kalman filter over distance in fixed point.
+    //
+    // Position is mm and velocity mm/s, both with FractionBits, the
+    // covariance terms with twice that.  Process noise is white
+    // acceleration of accelerationNoise mm/s^2 (one sigma); measurement
+    // variance is given per update so it can follow the signal level.
+    // Products use 64 bit intermediates, this runs at proximity rates not
+    // per pixel.
+    //
+    class DistanceKalman
+    {
+    public:
+        static constexpr uint8_t FractionBits = 4;
+
+        DistanceKalman(uint16_t accelerationNoise = 2000) :
+            c_AccelerationNoise(accelerationNoise)
+        {
+            Reset();
+        }
+
+        void Reset()
+        {
+            _primed = false;
+            _position = 0;
+            _velocity = 0;
+            _p00 = 0;
+            _p01 = 0;
+            _p11 = 0;
+        }
+
+        // measurement is mm with FractionBits and variance mm^2 with
+        // 2 * FractionBits, dtUs the time since the last update
+        void Update(int32_t measurement, uint32_t variance, uint32_t dtUs)
+        {
+            if (variance == 0)
+            {
+                variance = 1;
+            }
+
+            if (!_primed)
+            {
+                // start at the measurement, at rest, with a velocity
+                // uncertainty of one mm/s per mm/s^2 of process noise
+                _primed = true;
+                _position = measurement;
+                _velocity = 0;
+                _p00 = variance;
+                _p01 = 0;
+                _p11 = saturate(static_cast<int64_t>(c_AccelerationNoise) * c_AccelerationNoise << (2 * FractionBits));
+                return;
+            }
+
+            predict(dtUs);
+
+            // update with gains in Q15
+            int64_t s = static_cast<int64_t>(_p00) + variance;
+            int64_t k0 = (static_cast<int64_t>(_p00) << GainBits) / s;
+            int64_t k1 = (static_cast<int64_t>(_p01) << GainBits) / s;
+            int32_t innovation = measurement - _position;
+
+            _position += static_cast<int32_t>((k0 * innovation) >> GainBits);
+            _velocity += static_cast<int32_t>((k1 * innovation) >> GainBits);
+
+            int64_t p00 = _p00;
+            int64_t p01 = _p01;
+
+            _p00 = clampCovariance(p00 - ((k0 * p00) >> GainBits));
+            _p01 = saturate(p01 - ((k0 * p01) >> GainBits));
+            _p11 = clampCovariance(_p11 - ((k1 * p01) >> GainBits));
+        }
+
+        bool IsPrimed() const
+        {
+            return _primed;
+        }
+
+        // mm with FractionBits
+        int32_t Position() const
+        {
+            return _position;
+        }
+
+        // mm/s with FractionBits, negative while the target approaches
+        int32_t Velocity() const
+        {
+            return _velocity;
+        }
+
+        // mm^2 with 2 * FractionBits
+        int32_t PositionVariance() const
+        {
+            return _p00;
+        }
+
+    protected:
+        static constexpr uint8_t GainBits = 15;
+        static constexpr uint8_t DtBits = 16; // seconds
+        // keeps the velocity term of the prediction within 32 bits
+        static constexpr uint32_t MaxDtUs = 250000;
+
+        const uint16_t c_AccelerationNoise;
+
+        bool _primed;
+        int32_t _position;
+        int32_t _velocity;
+        int32_t _p00;
+        int32_t _p01;
+        int32_t _p11;
+
+        static int32_t saturate(int64_t value)
+        {
+            if (value > INT32_MAX)
+            {
+                return INT32_MAX;
+            }
+            if (value < INT32_MIN)
+            {
+                return INT32_MIN;
+            }
+            return static_cast<int32_t>(value);
+        }
+
+        static int32_t clampCovariance(int64_t value)
+        {
+            return (value < 1) ? 1 : saturate(value);
+        }
+
+        void predict(uint32_t dtUs)
+        {
+            if (dtUs > MaxDtUs)
+            {
+                dtUs = MaxDtUs;
+            }
+
+            // dt in seconds with DtBits
+            int64_t dt = (static_cast<int64_t>(dtUs) << DtBits) / 1000000;
+
+            _position += static_cast<int32_t>((static_cast<int64_t>(_velocity) * dt) >> DtBits);
+
+            // process noise is G * G' * a^2 with G = [dt^2/2, dt]
+            int64_t g1 = (static_cast<int64_t>(c_AccelerationNoise) * dt) >> (DtBits - FractionBits);
+            int64_t g0 = (g1 * dt) >> (DtBits + 1);
+
+            // P = F * P * F' + Q with F = [1, dt; 0, 1]
+            int64_t p11dt = (static_cast<int64_t>(_p11) * dt) >> DtBits;
+            int64_t p01 = _p01 + p11dt;
+
+            _p00 = clampCovariance(_p00 + ((static_cast<int64_t>(_p01) * dt) >> DtBits) + ((p01 * dt) >> DtBits) + g0 * g0);
+            _p01 = saturate(p01 + g0 * g1);
+            _p11 = clampCovariance(_p11 + g1 * g1);
+        }
+    };
+
+    // Smoothed distance and approach velocity from raw proximity counts,
+    // the 8 bit ADPS9960 and 16 bit ADPS9930 data both fit uint16_t.
+    //
+    // countNoise is the standard deviation of the counts at rest, it is
+    // scaled by the table's local slope, so far targets where a count is
+    // many mm are trusted less than near ones.  Counts beyond the table
+    // clamp, so a target out of range settles at the table's maximum.
+    //
+    template<class T_CLOCK = ADPS_UTIL::ClockMillis> class DistanceTracker
+    {
+    public:
+        DistanceTracker(const DistanceTable& table,
+                uint8_t countNoise = 2,
+                uint16_t accelerationNoise = 2000) :
+            _table(table),
+            _filter(accelerationNoise),
+            c_CountNoise(countNoise),
+            _timestamp(0)
+        {
+        }
+
+        void Update(uint16_t counts, uint32_t timestamp)
+        {
+            uint16_t slope;
+            uint16_t distance = _table.Interpolate(counts, &slope);
+
+            uint32_t sigma = static_cast<uint32_t>(slope) * c_CountNoise;
+            if (sigma == 0)
+            {
+                sigma = 1;
+            }
+
+            _filter.Update(distance,
+                sigma * sigma,
+                TicksToUs<T_CLOCK>(timestamp - _timestamp));
+            _timestamp = timestamp;
+        }
+
+        void Reset()
+        {
+            _filter.Reset();
+        }
+
+        uint16_t Millimetres() const
+        {
+            int32_t position = (_filter.Position() + (1 << (DistanceKalman::FractionBits - 1))) >> DistanceKalman::FractionBits;
+
+            return (position < 0) ? 0 : static_cast<uint16_t>(position);
+        }
+
+        // mm/s, positive while the target approaches
+        int16_t ApproachVelocity() const
+        {
+            int32_t velocity = -_filter.Velocity() / (1 << DistanceKalman::FractionBits);
+
+            if (velocity > INT16_MAX)
+            {
+                return INT16_MAX;
+            }
+            if (velocity < INT16_MIN)
+            {
+                return INT16_MIN;
+            }
+            return static_cast<int16_t>(velocity);
+        }
+
+        const DistanceKalman& Filter() const
+        {
+            return _filter;
+        }
+
+    protected:
+        DistanceTable _table; // a copy, only the points need to outlive the tracker
+        DistanceKalman _filter;
+        const uint8_t c_CountNoise;
+        uint32_t _timestamp;
+    };
+}
+
+namespace ADPS9960
+{
+    // A nominal inverse square curve for the defaults (8 pulses of 8us,
+    // 2x gain, 100mA) and a white target without cover glass, saturating
+    // at 15mm.  It only gives the shape, measure a table for real use.
+    //
+    constexpr ADPS_UTIL::DistancePoint DistanceTableNominal[] PROGMEM =
+    {
+        { 1, 200 }, { 3, 150 }, { 6, 100 }, { 9, 80 }, { 16, 60 }, { 23, 50 },
+        { 36, 40 }, { 64, 30 }, { 92, 25 }, { 143, 20 }, { 255, 15 }
+    };
+    static_assert(ADPS_UTIL::IsDistanceTableValid(DistanceTableNominal, countof(DistanceTableNominal)),
+        "DistanceTableNominal is not sorted");
+}
+
+namespace ADPS9930
+{
+    // A nominal inverse square curve for the defaults (1x gain, 100mA)
+    // with 8 pulses and a white target without cover glass, saturating at
+    // 20mm.  It only gives the shape, measure a table for real use.
+    //
+    constexpr ADPS_UTIL::DistancePoint DistanceTableNominal[] PROGMEM =
+    {
+        { 5, 300 }, { 10, 200 }, { 18, 150 }, { 41, 100 }, { 64, 80 }, { 114, 60 },
+        { 164, 50 }, { 256, 40 }, { 455, 30 }, { 655, 25 }, { 1023, 20 }
+    };
+    static_assert(ADPS_UTIL::IsDistanceTableValid(DistanceTableNominal, countof(DistanceTableNominal)),
+        "DistanceTableNominal is not sorted");
+}
@@ -0,0 +1,259 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+
+namespace ADPS_UTIL
+{
+    struct HealthMetrics
+    {
+        HealthMetrics() :
+            BusErrorCount(0),
+            IdMismatchCount(0),
+            ResetCount(0),
+            StuckCount(0),
+            RecoveryCount(0),
+            RecoveryFailedCount(0),
+            LastDetectUs(0),
+            LastRecoveryUs(0),
+            MaxRecoveryUs(0),
+            LastOutageUs(0),
+            MaxOutageUs(0)
+        {
+        }
+
+        uint16_t BusErrorCount;
+        uint16_t IdMismatchCount;
+        uint16_t ResetCount; // found powered down, a brown out
+        uint16_t StuckCount; // no new data within the stale time
+        uint16_t RecoveryCount;
+        uint16_t RecoveryFailedCount;
+
+        uint32_t LastDetectUs; // last good data until the fault was found
+        uint32_t LastRecoveryUs; // time spent re-applying the configuration
+        uint32_t MaxRecoveryUs;
+        uint32_t LastOutageUs; // fault found until good data again
+        uint32_t MaxOutageUs;
+    };
+
+    // Watches an Adps9960 or Adps9930 for brown outs and stuck states and
+    // re-applies the captured configuration with RestoreRegisterBank.
+    //
+    // Read the sensor through Update() rather than the Get*Data() methods,
+    // the snapshot it reads brings the ID, ENABLE and STATUS along with the
+    // data so checking costs no extra transactions.  On the Adps9930 new
+    // data is seen through the interrupt bits, which Update() latches, so
+    // keep the persistence at 0 (see ADPS9930::Snapshot::HasNewData).
+    //
+    // staleMs should be a few of the predicted device cycles, after that
+    // long without a completed ALS or proximity cycle the device is
+    // considered stuck and is power cycled.
+    //
+    // Call Capture() again after any deliberate configuration change.
+    //
+    template<class T_ADPS, class T_CLOCK = ClockMillis> class HealthMonitor
+    {
+    public:
+        typedef typename T_ADPS::SnapshotType SnapshotType;
+
+        HealthMonitor(uint32_t staleMs) :
+            c_StaleTicks(MsToTicks<T_CLOCK>(staleMs)),
+            _captured(false),
+            _faulted(false),
+            _lastGood(0),
+            _faultTime(0)
+        {
+        }
+
+        // captures the current configuration as the one to restore,
+        // call once the device is configured and started
+        bool Capture(T_ADPS& adps)
+        {
+            adps.ReadRegisterBank(_bank);
+            if (adps.LastError() != WIRE_UTIL::Error_None)
+            {
+                return false;
+            }
+
+            SnapshotType snapshot = adps.GetSnapshot();
+            if (adps.LastError() != WIRE_UTIL::Error_None)
+            {
+                return false;
+            }
+
+            _id = snapshot.Id;
+            _poweredOn = snapshot.IsPoweredOn();
+            _captured = true;
+            _faulted = false;
+            _lastGood = _clock.Now();
+            return true;
+        }
+
+        // reads a snapshot and checks it, recovering the device if needed;
+        // returns true when snapshot holds new data
+        bool Update(T_ADPS& adps, SnapshotType& snapshot)
+        {
+            uint32_t now = _clock.Now();
+
+            snapshot = adps.GetSnapshot();
+            if (adps.LastError() != WIRE_UTIL::Error_None)
+            {
+                _metrics.BusErrorCount++;
+                fault(now);
+                return false;
+            }
+            if (!_captured)
+            {
+                return newData(adps, snapshot);
+            }
+
+            if (snapshot.Id != _id)
+            {
+                // not our device answering or a corrupt transfer, retry later
+                _metrics.IdMismatchCount++;
+                fault(now);
+                return false;
+            }
+
+            if (_poweredOn && !snapshot.IsPoweredOn())
+            {
+                _metrics.ResetCount++;
+                recover(adps, now, false);
+                return false;
+            }
+
+            if (newData(adps, snapshot))
+            {
+                if (_faulted)
+                {
+                    _faulted = false;
+                    _metrics.LastOutageUs = TicksToUs<T_CLOCK>(now - _faultTime);
+                    if (_metrics.LastOutageUs > _metrics.MaxOutageUs)
+                    {
+                        _metrics.MaxOutageUs = _metrics.LastOutageUs;
+                    }
+                }
+                _lastGood = now;
+                return true;
+            }
+
+            if (snapshot.IsDataExpected() && (now - _lastGood) > c_StaleTicks)
+            {
+                _metrics.StuckCount++;
+                recover(adps, now, true);
+            }
+            return false;
+        }
+
+        bool IsHealthy() const
+        {
+            return !_faulted;
+        }
+
+        const HealthMetrics& Metrics() const
+        {
+            return _metrics;
+        }
+
+        void ResetMetrics()
+        {
+            _metrics = HealthMetrics();
+        }
+
+        T_CLOCK& Clock()
+        {
+            return _clock;
+        }
+
+    protected:
+        const uint32_t c_StaleTicks;
+
+        T_CLOCK _clock;
+        uint8_t _bank[T_ADPS::RegisterBankSize];
+        uint8_t _id;
+        bool _poweredOn;
+        bool _captured;
+        bool _faulted;
+        uint32_t _lastGood;
+        uint32_t _faultTime;
+        HealthMetrics _metrics;
+
+        bool newData(T_ADPS& adps, const SnapshotType& snapshot)
+        {
+            if (!snapshot.HasNewData())
+            {
+                return false;
+            }
+            // a latch failure shows up as a bus error on the next Update
+            adps.LatchSnapshot(snapshot);
+            return true;
+        }
+
+        void fault(uint32_t now)
+        {
+            if (!_faulted)
+            {
+                _faulted = true;
+                _faultTime = now;
+                _metrics.LastDetectUs = TicksToUs<T_CLOCK>(now - _lastGood);
+            }
+        }
+
+        void recover(T_ADPS& adps, uint32_t now, bool powerCycle)
+        {
+            fault(now);
+
+            if (powerCycle)
+            {
+                // ENABLE then differs from the captured bank and is 
+                // restored last, restarting the device
+                adps.Stop();
+            }
+            adps.RestoreRegisterBank(_bank);
+
+            uint32_t done = _clock.Now();
+            if (adps.LastError() != WIRE_UTIL::Error_None)
+            {
+                _metrics.RecoveryFailedCount++;
+                return;
+            }
+
+            _metrics.RecoveryCount++;
+            _metrics.LastRecoveryUs = TicksToUs<T_CLOCK>(done - now);
+            if (_metrics.LastRecoveryUs > _metrics.MaxRecoveryUs)
+            {
+                _metrics.MaxRecoveryUs = _metrics.LastRecoveryUs;
+            }
+
+            // allow the restarted device a full stale time to produce data
+            _lastGood = done;
+        }
+    };
+}
@@ -0,0 +1,208 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+#include "AdpsUtil.h"
+
+namespace ADPS_UTIL
+{
+    // Log policies provide
+    //    static constexpr bool Enabled
+    //    void Write(uint8_t event, args...) - up to LogMaxArgs integer args
+    //
+    // Records are binary, a header byte of (argc << 5 | event) followed by
+    // each argument as 16 bits little endian, and are formatted on the host
+    // by extras/LogDecoder.  Writing one costs a few stores, so unlike
+    // printing to Serial it doesn't change the timing of what is logged.
+    //
+    // events 0-15 are the library, 16-31 are free for the application
+    //
+    enum LogEvent
+    {
+        LogEvent_Dropped, // count of records lost to a full ring
+        LogEvent_Start, // enable register
+        LogEvent_Register, // register, value
+        LogEvent_GestureBegin,
+        LogEvent_GestureEnd,
+        LogEvent_GestureHeld,
+        LogEvent_GestureTooLong, // ms, state
+        LogEvent_GestureTooShort, // ms
+        LogEvent_GestureIntNoData,
+        LogEvent_FifoOverflow, // lost, fifo count
+
+        LogEvent_User = 16,
+        LogEvent_Last = 31
+    };
+
+    constexpr uint8_t LogMaxArgs = 7;
+    constexpr uint8_t LogEventMask = 0x1f;
+    constexpr uint8_t LogArgcShift = 5;
+
+    constexpr uint8_t LogRecordHeader(uint8_t event, uint8_t argc)
+    {
+        return static_cast<uint8_t>((argc << LogArgcShift) | (event & LogEventMask));
+    }
+
+    // logging compiled out
+    class LogNone
+    {
+    public:
+        static constexpr bool Enabled = false;
+
+        template<typename... T_ARGS> void Write(uint8_t, T_ARGS...)
+        {
+        }
+    };
+
+    // Records kept in a RAM ring of V_SIZE bytes (a power of two), drain it
+    // to a Stream when convenient.  When the ring is full new records are
+    // dropped and a LogEvent_Dropped record is written once there is room.
+    // Write and Drain must not be called from an ISR.
+    //
+    template<uint16_t V_SIZE> class LogRing
+    {
+    public:
+        static_assert(V_SIZE >= 16 && (V_SIZE & (V_SIZE - 1)) == 0, "V_SIZE must be a power of two of 16 or more");
+
+        static constexpr bool Enabled = true;
+
+        LogRing() :
+            _head(0),
+            _tail(0),
+            _dropped(0)
+        {
+        }
+
+        template<typename... T_ARGS> void Write(uint8_t event, T_ARGS... args)
+        {
+            static_assert(sizeof...(T_ARGS) <= LogMaxArgs, "too many log arguments");
+
+            // the trailing 0 keeps the array from being zero sized
+            const uint16_t values[] = { static_cast<uint16_t>(args)..., 0 };
+            const uint8_t argc = sizeof...(T_ARGS);
+
+            if (_dropped)
+            {
+                if (Free() < 3 + 1 + argc * 2)
+                {
+                    if (_dropped < 0xffff)
+                    {
+                        _dropped++;
+                    }
+                    return;
+                }
+                writeRecord(LogEvent_Dropped, &_dropped, 1);
+                _dropped = 0;
+            }
+
+            if (Free() < 1 + argc * 2)
+            {
+                _dropped++;
+                return;
+            }
+            writeRecord(event, values, argc);
+        }
+
+        uint16_t Available() const
+        {
+            return (_head - _tail) & Mask;
+        }
+
+        uint16_t Free() const
+        {
+            return Mask - Available();
+        }
+
+        uint8_t Read()
+        {
+            uint8_t value = _buffer[_tail];
+            _tail = (_tail + 1) & Mask;
+            return value;
+        }
+
+        // writes up to maxBytes of raw records to stream (anything with a
+        // write(uint8_t)), returns the count written
+        template<class T_STREAM> uint16_t Drain(T_STREAM& stream, uint16_t maxBytes = 0xffff)
+        {
+            uint16_t count = 0;
+
+            while (count < maxBytes && Available())
+            {
+                stream.write(Read());
+                count++;
+            }
+            return count;
+        }
+
+        void Clear()
+        {
+            _tail = _head;
+            _dropped = 0;
+        }
+
+    protected:
+        static constexpr uint16_t Mask = V_SIZE - 1;
+
+        uint8_t _buffer[V_SIZE];
+        uint16_t _head;
+        uint16_t _tail;
+        uint16_t _dropped;
+
+        void put(uint8_t value)
+        {
+            _buffer[_head] = value;
+            _head = (_head + 1) & Mask;
+        }
+
+        void writeRecord(uint8_t event, const uint16_t* values, uint8_t argc)
+        {
+            put(LogRecordHeader(event, argc));
+            for (uint8_t arg = 0; arg < argc; arg++)
+            {
+                put(values[arg] & 0xff);
+                put(values[arg] >> 8);
+            }
+        }
+    };
+
+    // Forwards to a single global log so the driver and the engine can
+    // share one ring,
+    //    ADPS_UTIL::LogRing<256> adpsLog;
+    //    typedef ADPS_UTIL::LogShared<ADPS_UTIL::LogRing<256>, adpsLog> AdpsLog;
+    //
+    template<class T_LOG, T_LOG& V_LOG> class LogShared
+    {
+    public:
+        static constexpr bool Enabled = T_LOG::Enabled;
+
+        template<typename... T_ARGS> void Write(uint8_t event, T_ARGS... args)
+        {
+            V_LOG.Write(event, args...);
+        }
+    };
+}
@@ -0,0 +1,616 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "Adps9960_types.h"
+#include "Adps9930_types.h"
+
+namespace ADPS_UTIL
+{
+    // SampleTraits expose a sample as Channels unsigned 16 bit values so
+    // the pipeline stages work on any of the library's sample types
+    //    static constexpr uint8_t Channels
+    //    static uint16_t Get(const T_SAMPLE& sample, uint8_t channel)
+    //    static void Set(T_SAMPLE& sample, uint8_t channel, uint16_t value)
+    //
+    // Stages only produce values within the range of their inputs, so Set
+    // never needs to saturate.  Specialize it for other sample types.
+    //
+    template<typename T_SAMPLE> struct SampleTraits;
+
+    template<> struct SampleTraits<uint8_t>
+    {
+        static constexpr uint8_t Channels = 1;
+
+        static uint16_t Get(const uint8_t& sample, uint8_t /* channel */)
+        {
+            return sample;
+        }
+
+        static void Set(uint8_t& sample, uint8_t /* channel */, uint16_t value)
+        {
+            sample = static_cast<uint8_t>(value);
+        }
+    };
+
+    template<> struct SampleTraits<uint16_t>
+    {
+        static constexpr uint8_t Channels = 1;
+
+        static uint16_t Get(const uint16_t& sample, uint8_t /* channel */)
+        {
+            return sample;
+        }
+
+        static void Set(uint16_t& sample, uint8_t /* channel */, uint16_t value)
+        {
+            sample = value;
+        }
+    };
+
+    template<> struct SampleTraits<ADPS9960::AlsData>
+    {
+        static constexpr uint8_t Channels = 4;
+
+        static uint16_t Get(const ADPS9960::AlsData& sample, uint8_t channel)
+        {
+            switch (channel)
+            {
+            case 0:
+                return sample.C;
+            case 1:
+                return sample.R;
+            case 2:
+                return sample.G;
+            default:
+                return sample.B;
+            }
+        }
+
+        static void Set(ADPS9960::AlsData& sample, uint8_t channel, uint16_t value)
+        {
+            switch (channel)
+            {
+            case 0:
+                sample.C = value;
+                break;
+            case 1:
+                sample.R = value;
+                break;
+            case 2:
+                sample.G = value;
+                break;
+            default:
+                sample.B = value;
+                break;
+            }
+        }
+    };
+
+    template<> struct SampleTraits<ADPS9960::GestureData>
+    {
+        static constexpr uint8_t Channels = 4;
+
+        static uint16_t Get(const ADPS9960::GestureData& sample, uint8_t channel)
+        {
+            return sample[channel];
+        }
+
+        static void Set(ADPS9960::GestureData& sample, uint8_t channel, uint16_t value)
+        {
+            uint8_t data = static_cast<uint8_t>(value);
+
+            switch (channel)
+            {
+            case 0:
+                sample.Up = data;
+                break;
+            case 1:
+                sample.Down = data;
+                break;
+            case 2:
+                sample.Left = data;
+                break;
+            default:
+                sample.Right = data;
+                break;
+            }
+        }
+    };
+
+    template<> struct SampleTraits<ADPS9930::AlsData>
+    {
+        static constexpr uint8_t Channels = 2;
+
+        static uint16_t Get(const ADPS9930::AlsData& sample, uint8_t channel)
+        {
+            return (channel == 0) ? sample.Ch0() : sample.Ch1();
+        }
+
+        static void Set(ADPS9930::AlsData& sample, uint8_t channel, uint16_t value)
+        {
+            if (channel == 0)
+            {
+                sample = ADPS9930::AlsData(value, sample.Ch1());
+            }
+            else
+            {
+                sample = ADPS9930::AlsData(sample.Ch0(), value);
+            }
+        }
+    };
+
+    // Pipeline stages
+    //
+    // Each stage is a descriptor with its parameters as template arguments
+    // and a nested Stage for the sample type that provides
+    //    bool Process(T_SAMPLE& sample)
+    //        filters the sample in place, false drops it (nothing after
+    //        the stage sees it)
+    //    void Reset()
+    //
+    // The first sample after a Reset primes the stage's history.  All math
+    // is integer, channels are independent.
+    //
+
+    // passes one of every V_FACTOR samples, put an average before it to
+    // avoid aliasing
+    template<uint8_t V_FACTOR> struct Decimate
+    {
+        static_assert(V_FACTOR > 0, "V_FACTOR must be at least 1");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& /* sample */)
+            {
+                if (_count == 0)
+                {
+                    _count = V_FACTOR - 1;
+                    return true;
+                }
+                _count--;
+                return false;
+            }
+
+            void Reset()
+            {
+                _count = 0;
+            }
+
+        private:
+            uint8_t _count;
+        };
+    };
+
+    // mean of the last V_WINDOW samples, a power of two window divides
+    // with a shift
+    template<uint8_t V_WINDOW> struct MovingAverage
+    {
+        static_assert(V_WINDOW > 0, "V_WINDOW must be at least 1");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    uint16_t value = Traits::Get(sample, channel);
+
+                    if (!_primed)
+                    {
+                        for (uint8_t index = 0; index < V_WINDOW; index++)
+                        {
+                            _window[channel][index] = value;
+                        }
+                        _sum[channel] = static_cast<uint32_t>(value) * V_WINDOW;
+                    }
+                    else
+                    {
+                        _sum[channel] += value;
+                        _sum[channel] -= _window[channel][_next];
+                        _window[channel][_next] = value;
+                    }
+                    Traits::Set(sample, channel, static_cast<uint16_t>(_sum[channel] / V_WINDOW));
+                }
+
+                _primed = true;
+                _next = (_next + 1) % V_WINDOW;
+                return true;
+            }
+
+            void Reset()
+            {
+                _primed = false;
+                _next = 0;
+            }
+
+        private:
+            bool _primed;
+            uint8_t _next;
+            uint32_t _sum[Traits::Channels];
+            uint16_t _window[Traits::Channels][V_WINDOW];
+        };
+    };
+
+    // median of the last V_WINDOW (odd) samples, removes single sample
+    // spikes without the lag an average has on steps
+    template<uint8_t V_WINDOW> struct Median
+    {
+        static_assert((V_WINDOW & 1) && V_WINDOW <= 15, "V_WINDOW must be odd and at most 15");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    uint16_t value = Traits::Get(sample, channel);
+
+                    if (!_primed)
+                    {
+                        for (uint8_t index = 0; index < V_WINDOW; index++)
+                        {
+                            _window[channel][index] = value;
+                        }
+                    }
+                    _window[channel][_next] = value;
+                    Traits::Set(sample, channel, median(_window[channel]));
+                }
+
+                _primed = true;
+                _next = (_next + 1) % V_WINDOW;
+                return true;
+            }
+
+            void Reset()
+            {
+                _primed = false;
+                _next = 0;
+            }
+
+        private:
+            bool _primed;
+            uint8_t _next;
+            uint16_t _window[Traits::Channels][V_WINDOW];
+
+            // insertion sort of a copy, cheaper than anything clever at
+            // these window sizes
+            static uint16_t median(const uint16_t* window)
+            {
+                uint16_t sorted[V_WINDOW];
+
+                for (uint8_t index = 0; index < V_WINDOW; index++)
+                {
+                    uint16_t value = window[index];
+                    uint8_t insert = index;
+
+                    while (insert > 0 && sorted[insert - 1] > value)
+                    {
+                        sorted[insert] = sorted[insert - 1];
+                        insert--;
+                    }
+                    sorted[insert] = value;
+                }
+                return sorted[V_WINDOW / 2];
+            }
+        };
+    };
+
+    // exponential moving average with a weight of 1/(2^V_SHIFT), the
+    // accumulator keeps V_SHIFT fractional bits so small steps still move it
+    template<uint8_t V_SHIFT> struct Ema
+    {
+        static_assert(V_SHIFT > 0 && V_SHIFT <= 15, "V_SHIFT must be 1 to 15");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    uint32_t value = Traits::Get(sample, channel);
+
+                    if (!_primed)
+                    {
+                        _accum[channel] = value << V_SHIFT;
+                    }
+                    else
+                    {
+                        _accum[channel] -= _accum[channel] >> V_SHIFT;
+                        _accum[channel] += value;
+                    }
+                    // rounded
+                    Traits::Set(sample, channel,
+                        static_cast<uint16_t>((_accum[channel] + (1UL << (V_SHIFT - 1))) >> V_SHIFT));
+                }
+
+                _primed = true;
+                return true;
+            }
+
+            void Reset()
+            {
+                _primed = false;
+            }
+
+        private:
+            bool _primed;
+            uint32_t _accum[Traits::Channels];
+        };
+    };
+
+    // replaces each channel with 1 once it reaches V_HIGH and 0 once it
+    // falls to V_LOW, follow it with ChangeDetector<1> for edge events
+    template<uint16_t V_LOW, uint16_t V_HIGH> struct Hysteresis
+    {
+        static_assert(V_LOW < V_HIGH, "V_LOW must be below V_HIGH");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    uint16_t value = Traits::Get(sample, channel);
+                    uint8_t mask = 1 << (channel & 7);
+                    uint8_t& state = _state[channel / 8];
+
+                    if (value >= V_HIGH)
+                    {
+                        state |= mask;
+                    }
+                    else if (value <= V_LOW)
+                    {
+                        state &= ~mask;
+                    }
+                    Traits::Set(sample, channel, (state & mask) ? 1 : 0);
+                }
+                return true;
+            }
+
+            void Reset()
+            {
+                for (uint8_t index = 0; index < countof(_state); index++)
+                {
+                    _state[index] = 0;
+                }
+            }
+
+        private:
+            uint8_t _state[(Traits::Channels + 7) / 8];
+        };
+    };
+
+    // passes a sample only when a channel moved at least V_DELTA from the
+    // last sample it passed, so later stages only run on changes
+    template<uint16_t V_DELTA> struct ChangeDetector
+    {
+        static_assert(V_DELTA > 0, "V_DELTA must be at least 1");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                bool changed = !_primed;
+
+                for (uint8_t channel = 0; channel < Traits::Channels && !changed; channel++)
+                {
+                    uint16_t value = Traits::Get(sample, channel);
+                    uint16_t last = _last[channel];
+                    uint16_t delta = (value > last) ? value - last : last - value;
+
+                    changed = (delta >= V_DELTA);
+                }
+
+                if (changed)
+                {
+                    for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                    {
+                        _last[channel] = Traits::Get(sample, channel);
+                    }
+                    _primed = true;
+                }
+                return changed;
+            }
+
+            void Reset()
+            {
+                _primed = false;
+            }
+
+        private:
+            bool _primed;
+            uint16_t _last[Traits::Channels];
+        };
+    };
+
+    // limits how far each channel moves per sample to V_MAX_STEP, a slew
+    // rate limit that turns steps into ramps
+    template<uint16_t V_MAX_STEP> struct RateLimiter
+    {
+        static_assert(V_MAX_STEP > 0, "V_MAX_STEP must be at least 1");
+
+        template<typename T_SAMPLE> class Stage
+        {
+        public:
+            typedef SampleTraits<T_SAMPLE> Traits;
+
+            Stage()
+            {
+                Reset();
+            }
+
+            bool Process(T_SAMPLE& sample)
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    uint16_t value = Traits::Get(sample, channel);
+
+                    if (_primed)
+                    {
+                        uint16_t last = _last[channel];
+
+                        if (value > last && value - last > V_MAX_STEP)
+                        {
+                            value = last + V_MAX_STEP;
+                        }
+                        else if (value < last && last - value > V_MAX_STEP)
+                        {
+                            value = last - V_MAX_STEP;
+                        }
+                        Traits::Set(sample, channel, value);
+                    }
+                    _last[channel] = value;
+                }
+
+                _primed = true;
+                return true;
+            }
+
+            void Reset()
+            {
+                _primed = false;
+            }
+
+        private:
+            bool _primed;
+            uint16_t _last[Traits::Channels];
+        };
+    };
+
+    template<typename T_SAMPLE, class... T_STAGES> class PipelineStages;
+
+    template<typename T_SAMPLE> class PipelineStages<T_SAMPLE>
+    {
+    public:
+        bool Process(T_SAMPLE& /* sample */)
+        {
+            return true;
+        }
+
+        void Reset()
+        {
+        }
+    };
+
+    template<typename T_SAMPLE, class T_FIRST, class... T_REST> class PipelineStages<T_SAMPLE, T_FIRST, T_REST...>
+    {
+    public:
+        bool Process(T_SAMPLE& sample)
+        {
+            return _first.Process(sample) && _rest.Process(sample);
+        }
+
+        void Reset()
+        {
+            _first.Reset();
+            _rest.Reset();
+        }
+
+    private:
+        typename T_FIRST::template Stage<T_SAMPLE> _first;
+        PipelineStages<T_SAMPLE, T_REST...> _rest;
+    };
+
+    // Composes stages in order over one sample type, for example
+    //
+    //    Pipeline<uint8_t, Median<3>, Ema<2>, Hysteresis<40, 60>, ChangeDetector<1>> near;
+    //    uint8_t proximity = adps.GetProximityData();
+    //    if (near.Process(proximity)) { /* proximity is now 1 near or 0 far */ }
+    //
+    // The stages are members rather than pointers and their parameters
+    // are constants, so Process inlines into one loop per stage with no
+    // virtual calls or heap.
+    //
+    template<typename T_SAMPLE, class... T_STAGES> class Pipeline
+    {
+    public:
+        // filters the sample in place, false when a stage dropped it and
+        // the sample is not valid
+        bool Process(T_SAMPLE& sample)
+        {
+            return _stages.Process(sample);
+        }
+
+        void Reset()
+        {
+            _stages.Reset();
+        }
+
+    private:
+        PipelineStages<T_SAMPLE, T_STAGES...> _stages;
+    };
+}
@@ -0,0 +1,329 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "AdpsClock.h"
+
+namespace ADPS_UTIL
+{
+    struct StreamReport
+    {
+        StreamReport() :
+            SampleCount(0),
+            Polls(0),
+            MissedCycles(0),
+            PeriodUs(0),
+            AchievedHz(0.0f),
+            JitterP50Us(0),
+            JitterP90Us(0),
+            JitterP99Us(0),
+            JitterMaxUs(0)
+        {
+        }
+
+        uint16_t SampleCount;
+        uint32_t Polls; // bus reads, SampleCount of them found new data
+        // intervals spanning several PeriodUs count the cycles lost to
+        // stalls (interrupts, retries); a device steadily faster than the
+        // bus shows as IsBusLimited instead
+        uint16_t MissedCycles;
+        uint32_t PeriodUs; // the median interval between samples
+        float AchievedHz;
+        // distance of each interval from PeriodUs (or the multiple of it
+        // after missed cycles), the histogram resolution is the bin width
+        uint16_t JitterP50Us;
+        uint16_t JitterP90Us;
+        uint16_t JitterP99Us;
+        uint16_t JitterMaxUs;
+
+        // every poll found new data, so the device may be faster than the
+        // bus and AchievedHz is the bus ceiling rather than the device's
+        bool IsBusLimited() const
+        {
+            return (SampleCount != 0 && Polls == SampleCount);
+        }
+    };
+
+    // Sample interval statistics in constant memory.  The first
+    // CalibrationIntervals set the period from their median, the jitter of
+    // every interval from it goes into V_BINS bins of binUs, the last bin
+    // collecting everything larger.
+    //
+    template<class T_CLOCK = ADPS_UTIL::ClockMicros, uint8_t V_BINS = 64> class StreamStats
+    {
+    public:
+        static constexpr uint8_t CalibrationIntervals = 15;
+
+        StreamStats(uint16_t binUs = 10) :
+            c_BinUs(binUs)
+        {
+            Reset();
+        }
+
+        void Reset()
+        {
+            _report = StreamReport();
+            _intervals = 0;
+            for (uint8_t bin = 0; bin < V_BINS; bin++)
+            {
+                _histogram[bin] = 0;
+            }
+        }
+
+        void AddPoll()
+        {
+            _report.Polls++;
+        }
+
+        // a poll that found a new sample at timestamp
+        void AddSample(uint32_t timestamp)
+        {
+            _report.Polls++;
+            if (_report.SampleCount == 0)
+            {
+                _first = timestamp;
+            }
+            else
+            {
+                uint32_t intervalUs = TicksToUs<T_CLOCK>(timestamp - _last);
+
+                if (_intervals < CalibrationIntervals)
+                {
+                    _calibration[_intervals] = intervalUs;
+                    if (_intervals == CalibrationIntervals - 1)
+                    {
+                        calibrate();
+                    }
+                }
+                else
+                {
+                    addInterval(intervalUs);
+                }
+                _intervals++;
+            }
+            _last = timestamp;
+            _report.SampleCount++;
+        }
+
+        StreamReport Report() const
+        {
+            StreamReport report = _report;
+            uint32_t elapsedUs = TicksToUs<T_CLOCK>(_last - _first);
+
+            if (report.SampleCount > 1 && elapsedUs)
+            {
+                report.AchievedHz = (report.SampleCount - 1) * 1000000.0f / elapsedUs;
+            }
+
+            uint32_t counted = 0;
+            for (uint8_t bin = 0; bin < V_BINS; bin++)
+            {
+                counted += _histogram[bin];
+            }
+
+            report.JitterP50Us = percentile(counted, 50);
+            report.JitterP90Us = percentile(counted, 90);
+            report.JitterP99Us = percentile(counted, 99);
+            return report;
+        }
+
+    protected:
+        const uint16_t c_BinUs;
+
+        StreamReport _report;
+        uint16_t _intervals;
+        uint32_t _first;
+        uint32_t _last;
+        uint32_t _calibration[CalibrationIntervals];
+        uint16_t _histogram[V_BINS];
+
+        void calibrate()
+        {
+            // insertion sort, it's only done once
+            for (uint8_t index = 1; index < CalibrationIntervals; index++)
+            {
+                uint32_t value = _calibration[index];
+                uint8_t insert = index;
+
+                while (insert > 0 && _calibration[insert - 1] > value)
+                {
+                    _calibration[insert] = _calibration[insert - 1];
+                    insert--;
+                }
+                _calibration[insert] = value;
+            }
+            _report.PeriodUs = _calibration[CalibrationIntervals / 2];
+            if (_report.PeriodUs == 0)
+            {
+                _report.PeriodUs = 1;
+            }
+
+            for (uint8_t index = 0; index < CalibrationIntervals; index++)
+            {
+                addInterval(_calibration[index]);
+            }
+        }
+
+        void addInterval(uint32_t intervalUs)
+        {
+            uint32_t period = _report.PeriodUs;
+            uint32_t cycles = (intervalUs + period / 2) / period;
+
+            if (cycles > 1)
+            {
+                _report.MissedCycles += cycles - 1;
+            }
+            else
+            {
+                cycles = 1;
+            }
+
+            uint32_t expected = cycles * period;
+            uint32_t jitter = (intervalUs > expected) ? intervalUs - expected : expected - intervalUs;
+
+            if (jitter > _report.JitterMaxUs)
+            {
+                _report.JitterMaxUs = (jitter > 0xffff) ? 0xffff : jitter;
+            }
+
+            uint32_t bin = jitter / c_BinUs;
+            if (bin >= V_BINS)
+            {
+                bin = V_BINS - 1;
+            }
+            if (_histogram[bin] < 0xffff)
+            {
+                _histogram[bin]++;
+            }
+        }
+
+        // the upper edge of the bin holding the percent point
+        uint16_t percentile(uint32_t counted, uint8_t percent) const
+        {
+            if (counted == 0)
+            {
+                return 0;
+            }
+
+            uint32_t target = (counted * percent + 99) / 100;
+            uint32_t total = 0;
+
+            for (uint8_t bin = 0; bin < V_BINS - 1; bin++)
+            {
+                total += _histogram[bin];
+                if (total >= target)
+                {
+                    uint32_t edge = static_cast<uint32_t>(bin + 1) * c_BinUs;
+                    return (edge < _report.JitterMaxUs) ? edge : _report.JitterMaxUs;
+                }
+            }
+            return _report.JitterMaxUs;
+        }
+    };
+
+    // Streams proximity at the device's maximum rate.
+    //
+    // Begin() puts the driver in its shortest proximity cycle, see
+    // StartProximityStream in Adps9960 and Adps9930, Read() then polls
+    // GetNewProximityData back to back and keeps each new sample.
+    // Report() gives the achieved rate, cycles missed because the bus
+    // was busy and the interval jitter, the real ceiling for the bus
+    // speed and platform in use.
+    //
+    // Begin() changes the configuration, restore it afterwards (see
+    // RestoreRegisterBank) to return to normal operation.
+    //
+    template<class T_ADPS, class T_CLOCK = ADPS_UTIL::ClockMicros> class ProximityStreamer
+    {
+    public:
+        typedef typename T_ADPS::ProximityType ProximityType;
+
+        ProximityStreamer(T_ADPS& adps, uint32_t timeoutUs = 100000, uint16_t binUs = 10) :
+            _adps(adps),
+            c_TimeoutUs(timeoutUs),
+            _stats(binUs)
+        {
+        }
+
+        void Begin()
+        {
+            _adps.StartProximityStream();
+        }
+
+        // fills buffer with up to count consecutive samples, returns how
+        // many; fewer on a bus error or no new sample within the timeout
+        uint16_t Read(ProximityType* buffer, uint16_t count)
+        {
+            uint16_t filled = 0;
+            uint32_t lastSample = _clock.Now();
+
+            _stats.Reset();
+            while (filled < count)
+            {
+                ProximityType proximity;
+                bool isNew = _adps.GetNewProximityData(proximity);
+                uint32_t now = _clock.Now();
+
+                if (_adps.LastError() != WIRE_UTIL::Error_None)
+                {
+                    break;
+                }
+
+                if (isNew)
+                {
+                    buffer[filled++] = proximity;
+                    _stats.AddSample(now);
+                    lastSample = now;
+                }
+                else
+                {
+                    _stats.AddPoll();
+                    if (TicksToUs<T_CLOCK>(now - lastSample) > c_TimeoutUs)
+                    {
+                        break;
+                    }
+                }
+            }
+            return filled;
+        }
+
+        StreamReport Report() const
+        {
+            return _stats.Report();
+        }
+
+    protected:
+        T_ADPS& _adps;
+        T_CLOCK _clock;
+        const uint32_t c_TimeoutUs;
+        StreamStats<T_CLOCK> _stats;
+    };
+}
@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <stdint.h>
+#include "AdpsUtil.h"
+
+namespace ADPS_UTIL
+{
+    // Register bank helpers shared by the drivers ReadRegisterBank,
+    // DiffRegisterBank and RestoreRegisterBank.  writable is a PROGMEM
+    // table of the configuration bits of each register and differences is
+    // a bit per register, bit n is the nth register of the bank.
+    //
+
+    inline bool IsRegisterBankDifferent(const uint8_t* differences, uint8_t index)
+    {
+        return (differences[index / 8] & _BV(index % 8));
+    }
+
+    inline uint8_t DiffRegisterBank(const uint8_t* bank,
+            const uint8_t* expected,
+            const uint8_t* writable,
+            uint8_t size,
+            uint8_t* differences)
+    {
+        uint8_t count = 0;
+
+        for (uint8_t index = 0; index < size; index++)
+        {
+            if (differences && (index % 8) == 0)
+            {
+                differences[index / 8] = 0;
+            }
+
+            uint8_t mask = pgm_read_byte(&writable[index]);
+            if ((bank[index] ^ expected[index]) & mask)
+            {
+                count++;
+                if (differences)
+                {
+                    differences[index / 8] |= _BV(index % 8);
+                }
+            }
+        }
+        return count;
+    }
+
+    // replaces the configuration bits of bank with those of expected,
+    // reserved bits keep what was read from the device
+    inline void MergeRegisterBank(uint8_t* bank,
+            const uint8_t* expected,
+            const uint8_t* writable,
+            uint8_t size)
+    {
+        for (uint8_t index = 0; index < size; index++)
+        {
+            uint8_t mask = pgm_read_byte(&writable[index]);
+            bank[index] = (bank[index] & ~mask) | (expected[index] & mask);
+        }
+    }
+
+    // count of consecutive differing registers starting at index
+    inline uint8_t RegisterBankRunLength(const uint8_t* differences,
+            uint8_t index,
+            uint8_t size,
+            uint8_t maxRun)
+    {
+        uint8_t count = 0;
+
+        while (index + count < size &&
+            count < maxRun &&
+            IsRegisterBankDifferent(differences, index + count))
+        {
+            count++;
+        }
+        return count;
+    }
+}
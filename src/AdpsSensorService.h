@@ -0,0 +1,375 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#if !defined(ARDUINO)
+
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+#include "AdpsPlatform.h"
+#include "AdpsClock.h"
+#include "WireUtil.h"
+#include "Gesture_types.h"
+
+namespace ADPS_UTIL
+{
+    // Single writer sequence lock, readers never block the writer and
+    // never see a partially written value.  The value is kept as relaxed
+    // atomic words so the concurrent copy is well defined.
+    //
+    template<typename T_VALUE> class SeqLock
+    {
+    public:
+        static_assert(std::is_trivially_copyable<T_VALUE>::value, "T_VALUE must be trivially copyable");
+
+        SeqLock() :
+            _sequence(0)
+        {
+            T_VALUE value = T_VALUE();
+            Write(value);
+        }
+
+        // only ever from one thread
+        void Write(const T_VALUE& value)
+        {
+            uint32_t words[WordCount] = {};
+            memcpy(words, &value, sizeof(T_VALUE));
+
+            uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+            _sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t index = 0; index < WordCount; index++)
+            {
+                _words[index].store(words[index], std::memory_order_relaxed);
+            }
+            _sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // wait free, false if a write was in progress and value is unchanged
+        bool TryRead(T_VALUE& value) const
+        {
+            uint32_t words[WordCount];
+
+            uint32_t before = _sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                return false;
+            }
+            for (size_t index = 0; index < WordCount; index++)
+            {
+                words[index] = _words[index].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) != before)
+            {
+                return false;
+            }
+
+            memcpy(&value, words, sizeof(T_VALUE));
+            return true;
+        }
+
+        // retries TryRead, a write takes a few hundred ns so this only
+        // spins when racing one
+        T_VALUE Read() const
+        {
+            T_VALUE value;
+
+            while (!TryRead(value))
+            {
+                std::this_thread::yield();
+            }
+            return value;
+        }
+
+        // incremented by two for each write
+        uint32_t Sequence() const
+        {
+            return _sequence.load(std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr size_t WordCount = (sizeof(T_VALUE) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+        std::atomic<uint32_t> _sequence;
+        std::atomic<uint32_t> _words[WordCount];
+    };
+
+    // Lock free single producer, single consumer queue of V_SIZE - 1 items,
+    // V_SIZE must be a power of two
+    //
+    template<typename T_VALUE, uint8_t V_SIZE> class SpscQueue
+    {
+    public:
+        static_assert(V_SIZE >= 2 && (V_SIZE & (V_SIZE - 1)) == 0, "V_SIZE must be a power of two");
+
+        SpscQueue() :
+            _head(0),
+            _tail(0)
+        {
+        }
+
+        // producer only, false if full
+        bool Push(const T_VALUE& value)
+        {
+            uint8_t head = _head.load(std::memory_order_relaxed);
+            uint8_t next = (head + 1) & Mask;
+
+            if (next == _tail.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            _items[head] = value;
+            _head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        // consumer only, false if empty
+        bool Pop(T_VALUE& value)
+        {
+            uint8_t tail = _tail.load(std::memory_order_relaxed);
+
+            if (tail == _head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            value = _items[tail];
+            _tail.store((tail + 1) & Mask, std::memory_order_release);
+            return true;
+        }
+
+        bool IsEmpty() const
+        {
+            return (_tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire));
+        }
+
+    private:
+        static constexpr uint8_t Mask = V_SIZE - 1;
+
+        std::atomic<uint8_t> _head;
+        std::atomic<uint8_t> _tail;
+        T_VALUE _items[V_SIZE];
+    };
+
+    struct GestureEvent
+    {
+        GestureEvent(ADPS9960::GestureVector gesture = ADPS9960::GestureVector_Unknown,
+                uint32_t timestamp = 0) :
+            Gesture(gesture),
+            Timestamp(timestamp)
+        {
+        }
+
+        ADPS9960::GestureVector Gesture;
+        uint32_t Timestamp; // ClockMicros ticks
+    };
+
+    // the default gesture source of a SensorService, no gestures
+    class GestureSourceNone
+    {
+    public:
+        template<class T_ADPS, typename T_CALLBACK> uint8_t Process(T_ADPS&, T_CALLBACK)
+        {
+            return 0;
+        }
+    };
+
+    // Owns a driver on a dedicated thread for host builds (Linux with
+    // LinuxI2cWire) where several threads want the sensor state.
+    //
+    // Every periodUs the thread reads a snapshot, which any number of
+    // threads can read with Latest() or TryLatest() without blocking the
+    // service or each other and without bus traffic.  Gestures from
+    // T_GESTURE_SOURCE (a GestureEngine) are queued for one consumer
+    // thread to take with NextGesture().
+    //
+    // The driver and gesture source are not thread safe, configure them
+    // before Start() or after Stop().
+    //
+    template<class T_ADPS,
+        class T_GESTURE_SOURCE = GestureSourceNone,
+        uint8_t V_GESTURE_QUEUE = 16> class SensorService
+    {
+    public:
+        struct Sample
+        {
+            Sample() :
+                Timestamp(0),
+                Error(WIRE_UTIL::Error_None)
+            {
+            }
+
+            typename T_ADPS::SnapshotType Snapshot;
+            uint32_t Timestamp; // ClockMicros ticks when read
+            uint8_t Error; // a failed read keeps the previous snapshot
+        };
+
+        SensorService(T_ADPS& adps, uint32_t periodUs) :
+            _adps(adps),
+            c_PeriodUs(periodUs),
+            _running(false),
+            _sampleCount(0),
+            _overrunCount(0),
+            _droppedGestureCount(0)
+        {
+        }
+
+        ~SensorService()
+        {
+            Stop();
+        }
+
+        bool Start()
+        {
+            if (_running.exchange(true))
+            {
+                return false;
+            }
+            _thread = std::thread(&SensorService::run, this);
+            return true;
+        }
+
+        void Stop()
+        {
+            if (_running.exchange(false))
+            {
+                _thread.join();
+            }
+        }
+
+        bool IsRunning() const
+        {
+            return _running.load();
+        }
+
+        // may spin briefly while racing a publish
+        Sample Latest() const
+        {
+            return _latest.Read();
+        }
+
+        // wait free, false while racing a publish
+        bool TryLatest(Sample& sample) const
+        {
+            return _latest.TryRead(sample);
+        }
+
+        // one consumer thread only
+        bool NextGesture(GestureEvent& event)
+        {
+            return _gestures.Pop(event);
+        }
+
+        T_GESTURE_SOURCE& GestureSource()
+        {
+            return _gestureSource;
+        }
+
+        uint32_t SampleCount() const
+        {
+            return _sampleCount.load(std::memory_order_relaxed);
+        }
+
+        // periods that started late because the previous one ran over
+        uint32_t OverrunCount() const
+        {
+            return _overrunCount.load(std::memory_order_relaxed);
+        }
+
+        // gestures lost because the queue was full
+        uint32_t DroppedGestureCount() const
+        {
+            return _droppedGestureCount.load(std::memory_order_relaxed);
+        }
+
+    private:
+        T_ADPS& _adps;
+        const uint32_t c_PeriodUs;
+        T_GESTURE_SOURCE _gestureSource;
+        ClockMicros _clock;
+
+        std::thread _thread;
+        std::atomic<bool> _running;
+        std::atomic<uint32_t> _sampleCount;
+        std::atomic<uint32_t> _overrunCount;
+        std::atomic<uint32_t> _droppedGestureCount;
+
+        SeqLock<Sample> _latest;
+        SpscQueue<GestureEvent, V_GESTURE_QUEUE> _gestures;
+
+        void run()
+        {
+            const std::chrono::microseconds period(c_PeriodUs);
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            Sample sample;
+
+            while (_running.load(std::memory_order_relaxed))
+            {
+                typename T_ADPS::SnapshotType snapshot = _adps.GetSnapshot();
+
+                sample.Timestamp = _clock.Now();
+                sample.Error = _adps.LastError();
+                if (sample.Error == WIRE_UTIL::Error_None)
+                {
+                    sample.Snapshot = snapshot;
+                }
+                _latest.Write(sample);
+                _sampleCount.fetch_add(1, std::memory_order_relaxed);
+
+                _gestureSource.Process(_adps, [this](ADPS9960::GestureVector gesture)
+                    {
+                        if (!_gestures.Push(GestureEvent(gesture, _clock.Now())))
+                        {
+                            _droppedGestureCount.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    });
+
+                next += period;
+
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (now > next)
+                {
+                    // late, skip the missed periods rather than bursting
+                    _overrunCount.fetch_add(1, std::memory_order_relaxed);
+                    next = now;
+                }
+                else
+                {
+                    std::this_thread::sleep_until(next);
+                }
+            }
+        }
+    };
+}
+
+#endif
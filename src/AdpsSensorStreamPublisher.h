@@ -0,0 +1,121 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#if !defined(ARDUINO)
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+#include "Gesture_types.h"
+#include "Adps9960_types.h"
+#include "Adps9930_types.h"
+#include "AdpsSensorService.h"
+#include "AdpsSharedRing.h"
+
+namespace ADPS_UTIL
+{
+    inline void ToRecordValues(const ADPS9960::AlsData& als, uint16_t values[4])
+    {
+        values[0] = als.C;
+        values[1] = als.R;
+        values[2] = als.G;
+        values[3] = als.B;
+    }
+
+    inline void ToRecordValues(const ADPS9930::AlsData& als, uint16_t values[4])
+    {
+        values[0] = als.Ch0();
+        values[1] = als.Ch1();
+        values[2] = 0;
+        values[3] = 0;
+    }
+
+    // Publishes what a SensorService reads, call Update() as often as the
+    // service period.  Each new sample becomes an ALS and a proximity
+    // record and each queued gesture a gesture record.
+    //
+    template<class T_SERVICE> class SensorStreamPublisher
+    {
+    public:
+        SensorStreamPublisher(T_SERVICE& service, SharedRingPublisher& ring) :
+            _service(service),
+            _ring(ring),
+            _lastTimestamp(0),
+            _hasPublished(false)
+        {
+        }
+
+        // returns the number of records published
+        uint8_t Update()
+        {
+            uint8_t published = 0;
+            typename T_SERVICE::Sample sample = _service.Latest();
+
+            if (sample.Timestamp != 0 &&
+                (!_hasPublished || sample.Timestamp != _lastTimestamp))
+            {
+                SensorRecord record;
+
+                _hasPublished = true;
+                _lastTimestamp = sample.Timestamp;
+
+                record.Timestamp = sample.Timestamp;
+                record.Error = sample.Error;
+
+                record.Type = SensorRecordType_Als;
+                ToRecordValues(sample.Snapshot.Als, record.Values);
+                _ring.Publish(record);
+
+                record.Type = SensorRecordType_Proximity;
+                record.Values[0] = sample.Snapshot.Proximity;
+                record.Values[1] = 0;
+                record.Values[2] = 0;
+                record.Values[3] = 0;
+                _ring.Publish(record);
+                published += 2;
+            }
+
+            GestureEvent event;
+            while (_service.NextGesture(event))
+            {
+                _ring.Publish(SensorRecordType_Gesture, event.Timestamp, WIRE_UTIL::Error_None, event.Gesture);
+                published++;
+            }
+            return published;
+        }
+
+    private:
+        T_SERVICE& _service;
+        SharedRingPublisher& _ring;
+        uint32_t _lastTimestamp;
+        bool _hasPublished;
+    };
+}
+
+#endif
@@ -0,0 +1,561 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#if !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+
+namespace ADPS_UTIL
+{
+    // Sensor streams published to POSIX shared memory so several processes
+    // can consume what one process (the owner of /dev/i2c) reads.
+    //
+    // One publisher writes fixed size records into a ring and never waits
+    // for readers.  Each reader keeps its own cursor, registered in the
+    // shared header so the publisher can see how far behind a consumer is.
+    // A reader that falls more than a ring behind skips ahead and counts
+    // the records it lost.
+    //
+    // Slots carry the record index + 1 once complete (the index while
+    // being written), so a reader checks the slot before and after using
+    // it to detect a record overwritten underneath it.
+    //
+
+    enum SensorRecordType
+    {
+        SensorRecordType_Als, // Values are C, R, G, B (9960) or Ch0, Ch1 (9930)
+        SensorRecordType_Proximity, // Values[0]
+        SensorRecordType_Gesture, // Values[0] is the GestureVector
+    };
+
+    struct SensorRecord
+    {
+        uint32_t Timestamp; // us, ClockMicros of the publisher
+        uint8_t Type;
+        uint8_t Error;
+        uint16_t Values[4];
+    };
+
+    constexpr uint32_t SharedRingMagic = 0x53504441; // "ADPS"
+    constexpr uint16_t SharedRingVersion = 1;
+    constexpr uint8_t SharedRingMaxConsumers = 8;
+
+    struct SharedRingConsumer
+    {
+        std::atomic<uint32_t> Pid; // 0 when the slot is free
+        std::atomic<uint32_t> Cursor;
+        std::atomic<uint32_t> LostCount;
+    };
+
+    struct SharedRingSlot
+    {
+        std::atomic<uint32_t> Sequence;
+        SensorRecord Record;
+    };
+
+    struct SharedRingHeader
+    {
+        uint32_t Magic;
+        uint16_t Version;
+        uint16_t RecordSize;
+        uint32_t Capacity;
+        std::atomic<uint32_t> WriteIndex; // records published
+        std::atomic<uint32_t> PublisherPid;
+        SharedRingConsumer Consumers[SharedRingMaxConsumers];
+    };
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared memory needs address free atomics");
+
+    // a process that exited without closing leaves its pid behind
+    inline bool IsProcessAlive(uint32_t pid)
+    {
+        return !(kill(pid, 0) != 0 && errno == ESRCH);
+    }
+
+    // maps a named region, the size of a ring of capacity records
+    class SharedRingMapping
+    {
+    public:
+        SharedRingMapping() :
+            _header(NULL),
+            _size(0)
+        {
+        }
+
+        ~SharedRingMapping()
+        {
+            Unmap();
+        }
+
+        static size_t SizeOf(uint32_t capacity)
+        {
+            return sizeof(SharedRingHeader) + capacity * sizeof(SharedRingSlot);
+        }
+
+        bool Map(const char* name, size_t size, bool create)
+        {
+            Unmap();
+
+            int fd = shm_open(name, create ? (O_CREAT | O_RDWR) : O_RDWR, 0644);
+            if (fd < 0)
+            {
+                return false;
+            }
+
+            if (create)
+            {
+                if (ftruncate(fd, size) != 0)
+                {
+                    close(fd);
+                    return false;
+                }
+            }
+            else
+            {
+                struct stat info;
+                if (fstat(fd, &info) != 0 ||
+                    static_cast<size_t>(info.st_size) < sizeof(SharedRingHeader))
+                {
+                    close(fd);
+                    return false;
+                }
+                size = info.st_size;
+            }
+
+            void* address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (address == MAP_FAILED)
+            {
+                return false;
+            }
+
+            _header = static_cast<SharedRingHeader*>(address);
+            _size = size;
+            return true;
+        }
+
+        void Unmap()
+        {
+            if (_header)
+            {
+                munmap(_header, _size);
+                _header = NULL;
+                _size = 0;
+            }
+        }
+
+        SharedRingHeader* Header() const
+        {
+            return _header;
+        }
+
+        size_t Size() const
+        {
+            return _size;
+        }
+
+        SharedRingSlot* Slots() const
+        {
+            return reinterpret_cast<SharedRingSlot*>(_header + 1);
+        }
+
+    private:
+        SharedRingHeader* _header;
+        size_t _size;
+    };
+
+    class SharedRingPublisher
+    {
+    public:
+        // capacity must be a power of two
+        SharedRingPublisher(const char* name, uint32_t capacity = 256) :
+            c_Capacity(capacity)
+        {
+            snprintf(_name, sizeof(_name), "%s", name);
+        }
+
+        // A ring left by an earlier publisher with the same layout is
+        // resumed, keeping WriteIndex and the consumers still alive, so
+        // mapped readers carry on.  Otherwise the name is replaced by a
+        // fresh ring and readers of the old one see the publisher gone.
+        bool Open()
+        {
+            if ((c_Capacity & (c_Capacity - 1)) != 0)
+            {
+                return false;
+            }
+
+            if (_mapping.Map(_name, 0, false))
+            {
+                if (resume())
+                {
+                    return true;
+                }
+                _mapping.Header()->PublisherPid.store(0, std::memory_order_release);
+                _mapping.Unmap();
+                shm_unlink(_name);
+            }
+
+            if (!_mapping.Map(_name, SharedRingMapping::SizeOf(c_Capacity), true))
+            {
+                return false;
+            }
+
+            SharedRingHeader* header = _mapping.Header();
+
+            // readers check the magic last, so it is written last
+            header->Magic = 0;
+            std::atomic_thread_fence(std::memory_order_release);
+            header->Version = SharedRingVersion;
+            header->RecordSize = sizeof(SensorRecord);
+            header->Capacity = c_Capacity;
+            header->WriteIndex.store(0, std::memory_order_relaxed);
+            header->PublisherPid.store(getpid(), std::memory_order_relaxed);
+            for (uint8_t index = 0; index < SharedRingMaxConsumers; index++)
+            {
+                header->Consumers[index].Pid.store(0, std::memory_order_relaxed);
+                header->Consumers[index].Cursor.store(0, std::memory_order_relaxed);
+                header->Consumers[index].LostCount.store(0, std::memory_order_relaxed);
+            }
+            for (uint32_t index = 0; index < c_Capacity; index++)
+            {
+                _mapping.Slots()[index].Sequence.store(0, std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_release);
+            header->Magic = SharedRingMagic;
+            return true;
+        }
+
+        void Close()
+        {
+            if (_mapping.Header())
+            {
+                _mapping.Header()->PublisherPid.store(0, std::memory_order_release);
+            }
+            _mapping.Unmap();
+        }
+
+        // removes the name, mapped readers keep working until they close
+        void Unlink()
+        {
+            shm_unlink(_name);
+        }
+
+        bool IsOpen() const
+        {
+            return (_mapping.Header() != NULL);
+        }
+
+        void Publish(const SensorRecord& record)
+        {
+            SharedRingHeader* header = _mapping.Header();
+            uint32_t index = header->WriteIndex.load(std::memory_order_relaxed);
+            SharedRingSlot& slot = _mapping.Slots()[index & (c_Capacity - 1)];
+
+            slot.Sequence.store(index, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.Record = record;
+            slot.Sequence.store(index + 1, std::memory_order_release);
+            header->WriteIndex.store(index + 1, std::memory_order_release);
+        }
+
+        void Publish(SensorRecordType type,
+                uint32_t timestamp,
+                uint8_t error,
+                uint16_t value0,
+                uint16_t value1 = 0,
+                uint16_t value2 = 0,
+                uint16_t value3 = 0)
+        {
+            SensorRecord record;
+
+            record.Timestamp = timestamp;
+            record.Type = type;
+            record.Error = error;
+            record.Values[0] = value0;
+            record.Values[1] = value1;
+            record.Values[2] = value2;
+            record.Values[3] = value3;
+            Publish(record);
+        }
+
+        // records the consumer in slot has yet to read, 0 if unused
+        uint32_t ConsumerLag(uint8_t consumer) const
+        {
+            const SharedRingHeader* header = _mapping.Header();
+            if (header->Consumers[consumer].Pid.load(std::memory_order_acquire) == 0)
+            {
+                return 0;
+            }
+            return header->WriteIndex.load(std::memory_order_relaxed) -
+                header->Consumers[consumer].Cursor.load(std::memory_order_relaxed);
+        }
+
+        uint32_t ConsumerLostCount(uint8_t consumer) const
+        {
+            return _mapping.Header()->Consumers[consumer].LostCount.load(std::memory_order_relaxed);
+        }
+
+    private:
+        const uint32_t c_Capacity;
+        char _name[64];
+        SharedRingMapping _mapping;
+
+        bool resume()
+        {
+            SharedRingHeader* header = _mapping.Header();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->Magic != SharedRingMagic ||
+                header->Version != SharedRingVersion ||
+                header->RecordSize != sizeof(SensorRecord) ||
+                header->Capacity != c_Capacity ||
+                _mapping.Size() < SharedRingMapping::SizeOf(c_Capacity))
+            {
+                return false;
+            }
+
+            // only the slots of consumers that exited without closing are freed
+            for (uint8_t index = 0; index < SharedRingMaxConsumers; index++)
+            {
+                uint32_t owner = header->Consumers[index].Pid.load(std::memory_order_acquire);
+                if (owner != 0 && !IsProcessAlive(owner))
+                {
+                    header->Consumers[index].Pid.compare_exchange_strong(owner, 0);
+                }
+            }
+            header->PublisherPid.store(getpid(), std::memory_order_release);
+            return true;
+        }
+    };
+
+    class SharedRingReader
+    {
+    public:
+        SharedRingReader(const char* name) :
+            _consumer(NULL),
+            _capacity(0),
+            _cursor(0),
+            _lostCount(0)
+        {
+            snprintf(_name, sizeof(_name), "%s", name);
+        }
+
+        ~SharedRingReader()
+        {
+            Close();
+        }
+
+        // fromOldest starts with the oldest record still in the ring,
+        // otherwise only records published after opening are read
+        bool Open(bool fromOldest = false)
+        {
+            Close();
+            if (!_mapping.Map(_name, 0, false))
+            {
+                return false;
+            }
+
+            SharedRingHeader* header = _mapping.Header();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->Magic != SharedRingMagic ||
+                header->Version != SharedRingVersion ||
+                header->RecordSize != sizeof(SensorRecord) ||
+                _mapping.Size() < SharedRingMapping::SizeOf(header->Capacity))
+            {
+                _mapping.Unmap();
+                return false;
+            }
+            _capacity = header->Capacity;
+
+            uint32_t pid = getpid();
+            for (uint8_t index = 0; index < SharedRingMaxConsumers && !_consumer; index++)
+            {
+                uint32_t owner = header->Consumers[index].Pid.load(std::memory_order_acquire);
+
+                // a consumer that exited without closing leaves its slot
+                if (owner != 0 && !IsProcessAlive(owner))
+                {
+                    header->Consumers[index].Pid.compare_exchange_strong(owner, 0);
+                    owner = 0;
+                }
+                if (owner == 0 &&
+                    header->Consumers[index].Pid.compare_exchange_strong(owner, pid))
+                {
+                    _consumer = &header->Consumers[index];
+                }
+            }
+            if (!_consumer)
+            {
+                _mapping.Unmap();
+                return false;
+            }
+
+            uint32_t newest = header->WriteIndex.load(std::memory_order_acquire);
+            _cursor = newest;
+            if (fromOldest)
+            {
+                _cursor = (newest > _capacity) ? newest - _capacity : 0;
+            }
+            _lostCount = 0;
+            _consumer->LostCount.store(0, std::memory_order_relaxed);
+            _consumer->Cursor.store(_cursor, std::memory_order_relaxed);
+            return true;
+        }
+
+        void Close()
+        {
+            if (_consumer)
+            {
+                _consumer->Pid.store(0, std::memory_order_release);
+                _consumer = NULL;
+            }
+            _mapping.Unmap();
+        }
+
+        bool IsOpen() const
+        {
+            return (_consumer != NULL);
+        }
+
+        // false when the publisher closed, exited or replaced the ring,
+        // Open() again to follow a new publisher
+        bool IsPublisherAlive() const
+        {
+            uint32_t pid = _mapping.Header()->PublisherPid.load(std::memory_order_acquire);
+            return (pid != 0 && IsProcessAlive(pid));
+        }
+
+        // Zero copy, the next record in place or NULL if there is none.
+        // Use it and then call Consume(), which returns false if it was
+        // overwritten meanwhile and what was read must be discarded.
+        const SensorRecord* Peek()
+        {
+            SharedRingHeader* header = _mapping.Header();
+
+            for (;;)
+            {
+                uint32_t newest = header->WriteIndex.load(std::memory_order_acquire);
+                if (newest == _cursor)
+                {
+                    return NULL;
+                }
+                if (newest - _cursor > _capacity)
+                {
+                    skipTo(newest - _capacity);
+                    continue;
+                }
+
+                SharedRingSlot& slot = _mapping.Slots()[_cursor & (_capacity - 1)];
+                if (slot.Sequence.load(std::memory_order_acquire) == _cursor + 1)
+                {
+                    return &slot.Record;
+                }
+                // lapped while looking, skip what was lost
+                skipTo(_cursor + 1);
+            }
+        }
+
+        bool Consume()
+        {
+            SharedRingSlot& slot = _mapping.Slots()[_cursor & (_capacity - 1)];
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            bool intact = (slot.Sequence.load(std::memory_order_relaxed) == _cursor + 1);
+            if (intact)
+            {
+                _cursor++;
+                _consumer->Cursor.store(_cursor, std::memory_order_relaxed);
+            }
+            else
+            {
+                skipTo(_cursor + 1);
+            }
+            return intact;
+        }
+
+        // copies the next record, false if there is none
+        bool Read(SensorRecord& record)
+        {
+            for (;;)
+            {
+                const SensorRecord* next = Peek();
+                if (!next)
+                {
+                    return false;
+                }
+                record = *next;
+                if (Consume())
+                {
+                    return true;
+                }
+            }
+        }
+
+        // records skipped because this reader fell more than a ring behind
+        uint32_t LostCount() const
+        {
+            return _lostCount;
+        }
+
+        uint32_t Available() const
+        {
+            return _mapping.Header()->WriteIndex.load(std::memory_order_acquire) - _cursor;
+        }
+
+    private:
+        char _name[64];
+        SharedRingMapping _mapping;
+        SharedRingConsumer* _consumer;
+        uint32_t _capacity;
+        uint32_t _cursor;
+        uint32_t _lostCount;
+
+        void skipTo(uint32_t cursor)
+        {
+            _lostCount += cursor - _cursor;
+            _cursor = cursor;
+            _consumer->Cursor.store(_cursor, std::memory_order_relaxed);
+            _consumer->LostCount.store(_lostCount, std::memory_order_relaxed);
+        }
+    };
+}
+
+#endif
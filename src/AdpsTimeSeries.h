@@ -0,0 +1,657 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsPipeline.h"
+
+namespace ADPS_UTIL
+{
+    // Compressed time series blocks
+    //
+    // A block is a header with its summary followed by bit packed samples,
+    // all little endian, decoded on the host by extras/TimeSeriesDecoder
+    //    0 magic (TimeSeriesMagic)
+    //    1 channel count
+    //    2 sample count (16)
+    //    4 sequence (32), counts blocks from the start of the log
+    //    8 first timestamp (32)
+    //    12 last timestamp (32)
+    //    16 payload length in bits (16)
+    //    18 min, max then mean per channel (16 each)
+    //
+    // The payload starts with the first sample's channels raw (16 bits
+    // each).  Every later sample is the delta of delta of its timestamp
+    // then the delta of each channel, zig-zag encoded and written with a
+    // prefix code that picks the payload width:
+    //    0 - zero, 10 - 4 bits, 110 - 8 bits, 1110 - 12 bits, 1111 - 32 bits
+    // so a steady period and an unchanged channel cost one bit each.
+    // Bits are packed from the least significant bit of each byte.
+    //
+    constexpr uint8_t TimeSeriesMagic = 0xA5;
+    constexpr uint8_t TimeSeriesMaxChannels = 8;
+    constexpr uint8_t TimeSeriesHeaderFixedSize = 18;
+
+    constexpr uint16_t TimeSeriesHeaderSize(uint8_t channels)
+    {
+        return TimeSeriesHeaderFixedSize + channels * 6;
+    }
+
+    // the summary of a block or of the blocks overlapping a range
+    template<uint8_t V_CHANNELS> struct TimeSeriesSummary
+    {
+        TimeSeriesSummary() :
+            SampleCount(0),
+            FirstTimestamp(0),
+            LastTimestamp(0)
+        {
+            for (uint8_t channel = 0; channel < V_CHANNELS; channel++)
+            {
+                Min[channel] = 0;
+                Max[channel] = 0;
+                Mean[channel] = 0;
+            }
+        }
+
+        uint32_t SampleCount;
+        uint32_t FirstTimestamp;
+        uint32_t LastTimestamp;
+        uint16_t Min[V_CHANNELS];
+        uint16_t Max[V_CHANNELS];
+        uint16_t Mean[V_CHANNELS];
+    };
+
+    namespace TimeSeriesCode
+    {
+        constexpr uint8_t BucketCount = 5;
+
+        inline uint8_t Width(uint8_t bucket)
+        {
+            return (bucket == 0) ? 0 :
+                (bucket == 1) ? 4 :
+                (bucket == 2) ? 8 :
+                (bucket == 3) ? 12 :
+                32;
+        }
+
+        inline uint8_t PrefixLength(uint8_t bucket)
+        {
+            return (bucket < BucketCount - 1) ? bucket + 1 : bucket;
+        }
+
+        inline uint8_t Bucket(uint32_t value)
+        {
+            uint8_t bucket = 0;
+
+            while (bucket < BucketCount - 1 &&
+                (Width(bucket) == 0 ? value != 0 : (value >> Width(bucket)) != 0))
+            {
+                bucket++;
+            }
+            return bucket;
+        }
+
+        inline uint8_t Bits(uint32_t value)
+        {
+            uint8_t bucket = Bucket(value);
+            return PrefixLength(bucket) + Width(bucket);
+        }
+
+        inline uint32_t ZigZag(int32_t value)
+        {
+            return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+        }
+
+        inline int32_t UnZigZag(uint32_t value)
+        {
+            return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+        }
+
+        inline uint16_t GetWord(const uint8_t* bytes)
+        {
+            return bytes[0] | (bytes[1] << 8);
+        }
+
+        inline uint32_t GetLong(const uint8_t* bytes)
+        {
+            return GetWord(bytes) | (static_cast<uint32_t>(GetWord(bytes + 2)) << 16);
+        }
+
+        inline void SetWord(uint8_t* bytes, uint16_t value)
+        {
+            bytes[0] = static_cast<uint8_t>(value);
+            bytes[1] = static_cast<uint8_t>(value >> 8);
+        }
+
+        inline void SetLong(uint8_t* bytes, uint32_t value)
+        {
+            SetWord(bytes, static_cast<uint16_t>(value));
+            SetWord(bytes + 2, static_cast<uint16_t>(value >> 16));
+        }
+    }
+
+    // Reads one block, on the device or the host
+    //
+    class TimeSeriesBlockReader
+    {
+    public:
+        // size is what is available, the block may be shorter
+        TimeSeriesBlockReader(const uint8_t* block, uint16_t size) :
+            _block(block),
+            _size(size)
+        {
+            Rewind();
+        }
+
+        bool IsValid() const
+        {
+            return _size >= TimeSeriesHeaderFixedSize &&
+                _block[0] == TimeSeriesMagic &&
+                Channels() > 0 &&
+                Channels() <= TimeSeriesMaxChannels &&
+                Size() <= _size;
+        }
+
+        uint8_t Channels() const
+        {
+            return _block[1];
+        }
+
+        uint16_t SampleCount() const
+        {
+            return TimeSeriesCode::GetWord(_block + 2);
+        }
+
+        uint32_t Sequence() const
+        {
+            return TimeSeriesCode::GetLong(_block + 4);
+        }
+
+        uint32_t FirstTimestamp() const
+        {
+            return TimeSeriesCode::GetLong(_block + 8);
+        }
+
+        uint32_t LastTimestamp() const
+        {
+            return TimeSeriesCode::GetLong(_block + 12);
+        }
+
+        uint16_t PayloadBits() const
+        {
+            return TimeSeriesCode::GetWord(_block + 16);
+        }
+
+        // header and payload bytes
+        uint16_t Size() const
+        {
+            return TimeSeriesHeaderSize(Channels()) + (PayloadBits() + 7) / 8;
+        }
+
+        uint16_t Min(uint8_t channel) const
+        {
+            return TimeSeriesCode::GetWord(_block + TimeSeriesHeaderFixedSize + channel * 2);
+        }
+
+        uint16_t Max(uint8_t channel) const
+        {
+            return TimeSeriesCode::GetWord(_block + TimeSeriesHeaderFixedSize + (Channels() + channel) * 2);
+        }
+
+        uint16_t Mean(uint8_t channel) const
+        {
+            return TimeSeriesCode::GetWord(_block + TimeSeriesHeaderFixedSize + (Channels() * 2 + channel) * 2);
+        }
+
+        void Rewind()
+        {
+            _index = 0;
+            _bit = 0;
+            _delta = 0;
+        }
+
+        // decodes the next sample, values holds Channels()
+        bool Next(uint32_t& timestamp, uint16_t* values)
+        {
+            if (_index >= SampleCount())
+            {
+                return false;
+            }
+
+            uint8_t channels = Channels();
+
+            if (_index == 0)
+            {
+                _timestamp = FirstTimestamp();
+                for (uint8_t channel = 0; channel < channels; channel++)
+                {
+                    _values[channel] = static_cast<uint16_t>(readBits(16));
+                }
+            }
+            else
+            {
+                _delta += TimeSeriesCode::UnZigZag(readCode());
+                _timestamp += _delta;
+                for (uint8_t channel = 0; channel < channels; channel++)
+                {
+                    _values[channel] += static_cast<uint16_t>(TimeSeriesCode::UnZigZag(readCode()));
+                }
+            }
+
+            if (_bit > PayloadBits())
+            {
+                // corrupt, ran past the payload
+                _index = SampleCount();
+                return false;
+            }
+
+            timestamp = _timestamp;
+            for (uint8_t channel = 0; channel < channels; channel++)
+            {
+                values[channel] = _values[channel];
+            }
+            _index++;
+            return true;
+        }
+
+    private:
+        const uint8_t* _block;
+        const uint16_t _size;
+        uint16_t _index;
+        uint16_t _bit;
+        int32_t _delta;
+        uint32_t _timestamp;
+        uint16_t _values[TimeSeriesMaxChannels];
+
+        uint32_t readBits(uint8_t count)
+        {
+            const uint8_t* payload = _block + TimeSeriesHeaderSize(Channels());
+            uint32_t value = 0;
+
+            for (uint8_t bit = 0; bit < count; bit++, _bit++)
+            {
+                // stays within the block even when corrupt
+                if (_bit < PayloadBits() && (payload[_bit / 8] & (1 << (_bit % 8))))
+                {
+                    value |= static_cast<uint32_t>(1) << bit;
+                }
+            }
+            return value;
+        }
+
+        uint32_t readCode()
+        {
+            uint8_t bucket = 0;
+
+            while (bucket < TimeSeriesCode::BucketCount - 1 && readBits(1))
+            {
+                bucket++;
+            }
+            return readBits(TimeSeriesCode::Width(bucket));
+        }
+    };
+
+    typedef void(*TimeSeriesSealedCallback)(const uint8_t* block, uint16_t size);
+
+    // Logs samples into a ring of V_BLOCK_COUNT compressed blocks of
+    // V_BLOCK_SIZE bytes, one of them the open block, overwriting the
+    // oldest sealed block when full.  Any sample type with SampleTraits
+    // (see AdpsPipeline.h) works, AlsData is four channels and proximity
+    // one.
+    //
+    // Each sealed block keeps its min, max and mean per channel in the
+    // header, so Query() answers range summaries without decoding.  Give
+    // a SealedCallback to copy each block to flash as it is sealed.
+    //
+    // Timestamps are any wrapping 32 bit ticks, a steady sample period
+    // costs one bit per sample.
+    //
+    template<typename T_SAMPLE,
+        uint16_t V_BLOCK_SIZE = 256,
+        uint8_t V_BLOCK_COUNT = 8> class TimeSeriesLog
+    {
+    public:
+        typedef SampleTraits<T_SAMPLE> Traits;
+        typedef TimeSeriesSummary<Traits::Channels> SummaryType;
+
+        static_assert(Traits::Channels <= TimeSeriesMaxChannels, "too many channels");
+        static_assert(V_BLOCK_SIZE >= 64 && V_BLOCK_SIZE <= 4096, "V_BLOCK_SIZE must be 64 to 4096");
+        static_assert(V_BLOCK_COUNT >= 2, "V_BLOCK_COUNT must be at least 2");
+
+        static constexpr uint16_t HeaderSize = TimeSeriesHeaderFixedSize + Traits::Channels * 6;
+
+        TimeSeriesLog() :
+            _sealedCallback(NULL),
+            _sequence(0),
+            _first(0),
+            _sealedCount(0)
+        {
+            startBlock();
+        }
+
+        void SetSealedCallback(TimeSeriesSealedCallback callback)
+        {
+            _sealedCallback = callback;
+        }
+
+        void Append(const T_SAMPLE& sample, uint32_t timestamp)
+        {
+            uint16_t values[Traits::Channels];
+
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                values[channel] = Traits::Get(sample, channel);
+            }
+
+            if (_count != 0 && _bits + sampleBits(values, timestamp) > PayloadCapacity)
+            {
+                Flush();
+            }
+
+            if (_count == 0)
+            {
+                _firstTimestamp = timestamp;
+                _delta = 0;
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    writeBits(values[channel], 16);
+                    _min[channel] = values[channel];
+                    _max[channel] = values[channel];
+                    _sum[channel] = 0;
+                }
+            }
+            else
+            {
+                int32_t delta = static_cast<int32_t>(timestamp - _lastTimestamp);
+
+                writeCode(TimeSeriesCode::ZigZag(delta - _delta));
+                _delta = delta;
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    writeCode(TimeSeriesCode::ZigZag(static_cast<int32_t>(values[channel]) - _last[channel]));
+                }
+            }
+
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                uint16_t value = values[channel];
+
+                if (value < _min[channel])
+                {
+                    _min[channel] = value;
+                }
+                if (value > _max[channel])
+                {
+                    _max[channel] = value;
+                }
+                _sum[channel] += value;
+                _last[channel] = value;
+            }
+            _lastTimestamp = timestamp;
+            _count++;
+        }
+
+        // seals the open block, an empty one is left as is
+        void Flush()
+        {
+            if (_count == 0)
+            {
+                return;
+            }
+
+            uint8_t* block = openBlock();
+
+            block[0] = TimeSeriesMagic;
+            block[1] = Traits::Channels;
+            TimeSeriesCode::SetWord(block + 2, _count);
+            TimeSeriesCode::SetLong(block + 4, _sequence);
+            TimeSeriesCode::SetLong(block + 8, _firstTimestamp);
+            TimeSeriesCode::SetLong(block + 12, _lastTimestamp);
+            TimeSeriesCode::SetWord(block + 16, _bits);
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                uint8_t* summary = block + TimeSeriesHeaderFixedSize + channel * 2;
+
+                TimeSeriesCode::SetWord(summary, _min[channel]);
+                TimeSeriesCode::SetWord(summary + Traits::Channels * 2, _max[channel]);
+                TimeSeriesCode::SetWord(summary + Traits::Channels * 4, mean(channel));
+            }
+
+            if (_sealedCallback)
+            {
+                _sealedCallback(block, HeaderSize + (_bits + 7) / 8);
+            }
+
+            _sequence++;
+            if (_sealedCount < V_BLOCK_COUNT - 1)
+            {
+                _sealedCount++;
+            }
+            else
+            {
+                // the oldest is overwritten
+                _first = (_first + 1) % V_BLOCK_COUNT;
+            }
+            startBlock();
+        }
+
+        // sealed blocks, oldest first
+        uint8_t BlockCount() const
+        {
+            return _sealedCount;
+        }
+
+        TimeSeriesBlockReader Block(uint8_t index) const
+        {
+            return TimeSeriesBlockReader(_blocks[(_first + index) % V_BLOCK_COUNT], V_BLOCK_SIZE);
+        }
+
+        // samples in the open block
+        uint16_t PendingCount() const
+        {
+            return _count;
+        }
+
+        // Summarizes every block overlapping from - to, including the open
+        // one, from the block summaries only; the result is block granular,
+        // its First and LastTimestamp give the span actually covered.
+        // Returns false when no block overlaps.
+        bool Query(uint32_t from, uint32_t to, SummaryType& summary) const
+        {
+            uint32_t sums[Traits::Channels];
+
+            summary = SummaryType();
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                sums[channel] = 0;
+            }
+
+            for (uint8_t index = 0; index < _sealedCount; index++)
+            {
+                TimeSeriesBlockReader block = Block(index);
+
+                if (overlaps(block.FirstTimestamp(), block.LastTimestamp(), from, to))
+                {
+                    uint16_t count = block.SampleCount();
+
+                    for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                    {
+                        include(summary, sums, channel, block.Min(channel), block.Max(channel),
+                            static_cast<uint32_t>(block.Mean(channel)) * count);
+                    }
+                    span(summary, block.FirstTimestamp(), block.LastTimestamp(), count);
+                }
+            }
+
+            if (_count && overlaps(_firstTimestamp, _lastTimestamp, from, to))
+            {
+                for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+                {
+                    include(summary, sums, channel, _min[channel], _max[channel], _sum[channel]);
+                }
+                span(summary, _firstTimestamp, _lastTimestamp, _count);
+            }
+
+            if (summary.SampleCount == 0)
+            {
+                return false;
+            }
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                summary.Mean[channel] = static_cast<uint16_t>((sums[channel] + summary.SampleCount / 2) / summary.SampleCount);
+            }
+            return true;
+        }
+
+        // writes the sealed blocks, oldest first, for TimeSeriesDecoder
+        template<class T_STREAM> void Drain(T_STREAM& stream) const
+        {
+            for (uint8_t index = 0; index < _sealedCount; index++)
+            {
+                TimeSeriesBlockReader block = Block(index);
+                const uint8_t* bytes = _blocks[(_first + index) % V_BLOCK_COUNT];
+
+                for (uint16_t offset = 0; offset < block.Size(); offset++)
+                {
+                    stream.write(bytes[offset]);
+                }
+            }
+        }
+
+    protected:
+        static constexpr uint16_t PayloadCapacity = (V_BLOCK_SIZE - HeaderSize) * 8;
+
+        TimeSeriesSealedCallback _sealedCallback;
+        uint32_t _sequence;
+        uint8_t _first; // oldest sealed block
+        uint8_t _sealedCount;
+
+        // the open block, after the sealed ones
+        uint16_t _count;
+        uint16_t _bits;
+        uint32_t _firstTimestamp;
+        uint32_t _lastTimestamp;
+        int32_t _delta;
+        uint16_t _last[Traits::Channels];
+        uint16_t _min[Traits::Channels];
+        uint16_t _max[Traits::Channels];
+        uint32_t _sum[Traits::Channels];
+
+        uint8_t _blocks[V_BLOCK_COUNT][V_BLOCK_SIZE];
+
+        uint8_t* openBlock()
+        {
+            return _blocks[(_first + _sealedCount) % V_BLOCK_COUNT];
+        }
+
+        void startBlock()
+        {
+            _count = 0;
+            _bits = 0;
+
+            uint8_t* payload = openBlock() + HeaderSize;
+            for (uint16_t index = 0; index < V_BLOCK_SIZE - HeaderSize; index++)
+            {
+                payload[index] = 0;
+            }
+            // not a block until sealed
+            openBlock()[0] = 0;
+        }
+
+        uint16_t mean(uint8_t channel) const
+        {
+            return static_cast<uint16_t>((_sum[channel] + _count / 2) / _count);
+        }
+
+        uint16_t sampleBits(const uint16_t* values, uint32_t timestamp) const
+        {
+            int32_t delta = static_cast<int32_t>(timestamp - _lastTimestamp);
+            uint16_t bits = TimeSeriesCode::Bits(TimeSeriesCode::ZigZag(delta - _delta));
+
+            for (uint8_t channel = 0; channel < Traits::Channels; channel++)
+            {
+                bits += TimeSeriesCode::Bits(TimeSeriesCode::ZigZag(static_cast<int32_t>(values[channel]) - _last[channel]));
+            }
+            return bits;
+        }
+
+        void writeBits(uint32_t value, uint8_t count)
+        {
+            uint8_t* payload = openBlock() + HeaderSize;
+
+            for (uint8_t bit = 0; bit < count; bit++, _bits++)
+            {
+                if (value & (static_cast<uint32_t>(1) << bit))
+                {
+                    payload[_bits / 8] |= 1 << (_bits % 8);
+                }
+            }
+        }
+
+        void writeCode(uint32_t value)
+        {
+            uint8_t bucket = TimeSeriesCode::Bucket(value);
+
+            // unary bucket prefix, the last bucket has no terminating zero
+            writeBits((1UL << bucket) - 1, TimeSeriesCode::PrefixLength(bucket));
+            writeBits(value, TimeSeriesCode::Width(bucket));
+        }
+
+        static bool overlaps(uint32_t first, uint32_t last, uint32_t from, uint32_t to)
+        {
+            return !(static_cast<int32_t>(last - from) < 0 || static_cast<int32_t>(first - to) > 0);
+        }
+
+        static void include(SummaryType& summary,
+            uint32_t* sums,
+            uint8_t channel,
+            uint16_t min,
+            uint16_t max,
+            uint32_t sum)
+        {
+            if (summary.SampleCount == 0 || min < summary.Min[channel])
+            {
+                summary.Min[channel] = min;
+            }
+            if (summary.SampleCount == 0 || max > summary.Max[channel])
+            {
+                summary.Max[channel] = max;
+            }
+            sums[channel] += sum;
+        }
+
+        static void span(SummaryType& summary, uint32_t first, uint32_t last, uint16_t count)
+        {
+            if (summary.SampleCount == 0)
+            {
+                summary.FirstTimestamp = first;
+            }
+            summary.LastTimestamp = last;
+            summary.SampleCount += count;
+        }
+    };
+}
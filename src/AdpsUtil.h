@@ -65,5 +65,19 @@ License along with Rtc.  If not, see
 #define _BV(b) (1UL << (b))
 #endif
 
+// tables are kept in flash on platforms that separate it (AVR),
+// elsewhere they are ordinary const data
+#if !defined(PROGMEM)
+#define PROGMEM
+#endif
+
+#if !defined(pgm_read_byte)
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t*>(addr))
+#endif
+
+#if !defined(pgm_read_word)
+#define pgm_read_word(addr) (*reinterpret_cast<const uint16_t*>(addr))
+#endif
+
 
 
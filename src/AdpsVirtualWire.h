@@ -0,0 +1,264 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#include "AdpsPlatform.h"
+#include "AdpsUtil.h"
+#include "WireUtil.h"
+
+namespace WIRE_UTIL
+{
+    // a plain 256 register device for VirtualWire, derive from it to
+    // model registers with side effects (data that changes, FIFOs)
+    class VirtualRegisterFile
+    {
+    public:
+        VirtualRegisterFile()
+        {
+            for (uint16_t index = 0; index < countof(Registers); index++)
+            {
+                Registers[index] = 0;
+            }
+        }
+
+        uint8_t Read(uint8_t reg)
+        {
+            return Registers[reg];
+        }
+
+        void Write(uint8_t reg, uint8_t value)
+        {
+            Registers[reg] = value;
+        }
+
+        uint8_t Registers[256];
+    };
+
+    // A T_WIRE_METHOD with a simulated device behind it, so drivers and
+    // the layers above them can run end to end without hardware.
+    //
+    // The first byte written selects the register and the pointer auto
+    // increments.  With commandProtocol the first byte is an ADPS9930
+    // style command: bits 0-4 the register, bits 5-6 the transaction type
+    // (repeated, auto increment, special function which is ignored).
+    //
+    // Failures can be injected for the next transactions with FailNext().
+    //
+    template<class T_DEVICE = VirtualRegisterFile> class VirtualWire
+    {
+    public:
+        VirtualWire(uint8_t address = 0x39, bool commandProtocol = false) :
+            c_Address(address),
+            c_CommandProtocol(commandProtocol),
+            _pointer(0),
+            _autoIncrement(true),
+            _special(false),
+            _address(0),
+            _txLength(0),
+            _rxLength(0),
+            _rxIndex(0),
+            _failCount(0),
+            _failError(Error_None),
+            _transactionCount(0)
+        {
+        }
+
+        void begin()
+        {
+        }
+
+        void begin(int, int)
+        {
+        }
+
+        void beginTransmission(uint8_t address)
+        {
+            _address = address;
+            _txLength = 0;
+        }
+
+        size_t write(uint8_t value)
+        {
+            if (_txLength >= BufferLength)
+            {
+                return 0;
+            }
+            _tx[_txLength++] = value;
+            return 1;
+        }
+
+        uint8_t endTransmission(bool sendStop = true)
+        {
+            (void)sendStop;
+
+            uint8_t error = transaction();
+            if (error != Error_None)
+            {
+                return error;
+            }
+
+            for (uint8_t index = 0; index < _txLength; index++)
+            {
+                if (index == 0)
+                {
+                    setPointer(_tx[0]);
+                }
+                else if (!_special)
+                {
+                    _device.Write(_pointer, _tx[index]);
+                    advance();
+                }
+            }
+            return Error_None;
+        }
+
+        uint8_t requestFrom(uint8_t address, uint8_t count, bool sendStop = true)
+        {
+            (void)sendStop;
+
+            _address = address;
+            _rxLength = 0;
+            _rxIndex = 0;
+            if (transaction() != Error_None)
+            {
+                return 0;
+            }
+
+            if (count > BufferLength)
+            {
+                count = BufferLength;
+            }
+            for (uint8_t index = 0; index < count; index++)
+            {
+                _rx[index] = _device.Read(_pointer);
+                advance();
+            }
+            _rxLength = count;
+            return count;
+        }
+
+        int available() const
+        {
+            return _rxLength - _rxIndex;
+        }
+
+        int read()
+        {
+            if (_rxIndex >= _rxLength)
+            {
+                return -1;
+            }
+            return _rx[_rxIndex++];
+        }
+
+        int peek() const
+        {
+            if (_rxIndex >= _rxLength)
+            {
+                return -1;
+            }
+            return _rx[_rxIndex];
+        }
+
+        // the next count transactions fail with error
+        void FailNext(uint8_t count, uint8_t error = Error_NoAddressableDevice)
+        {
+            _failCount = count;
+            _failError = error;
+        }
+
+        uint32_t TransactionCount() const
+        {
+            return _transactionCount;
+        }
+
+        T_DEVICE& Device()
+        {
+            return _device;
+        }
+
+    private:
+        const uint8_t c_Address;
+        const bool c_CommandProtocol;
+
+        T_DEVICE _device;
+        uint8_t _pointer;
+        bool _autoIncrement;
+        bool _special;
+        uint8_t _address;
+
+        uint8_t _tx[BufferLength];
+        uint8_t _txLength;
+        uint8_t _rx[BufferLength];
+        uint8_t _rxLength;
+        uint8_t _rxIndex;
+
+        uint8_t _failCount;
+        uint8_t _failError;
+        uint32_t _transactionCount;
+
+        uint8_t transaction()
+        {
+            _transactionCount++;
+            if (_failCount)
+            {
+                _failCount--;
+                return _failError;
+            }
+            if (_address != c_Address)
+            {
+                return Error_NoAddressableDevice;
+            }
+            return Error_None;
+        }
+
+        void setPointer(uint8_t value)
+        {
+            if (c_CommandProtocol)
+            {
+                uint8_t type = (value >> 5) & 0x03;
+
+                _pointer = value & 0x1f;
+                _autoIncrement = (type == 0x01);
+                _special = (type == 0x03);
+            }
+            else
+            {
+                _pointer = value;
+            }
+        }
+
+        void advance()
+        {
+            if (_autoIncrement)
+            {
+                _pointer++;
+            }
+        }
+    };
+}
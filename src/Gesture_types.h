@@ -62,13 +62,17 @@ public:
         }
     }
 
+    // ------------------------------------------------------------------------
+    // operator [] - readonly
+    // idx 0 is the oldest value and Count - 1 the newest
+    // ------------------------------------------------------------------------
     T_VALUE operator[](size_t idx) const
     {
         if (idx >= Count)
         {
             idx = Count - 1;
         }
-        return _queue[idx];
+        return _queue[(_back + idx) % Count];
     }
 
     const size_t Count;
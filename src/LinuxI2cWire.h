@@ -0,0 +1,351 @@
+/*-------------------------------------------------------------------------
+ADPS library
+
+Written by Michael C. Miller.
+
+I invest time and resources providing this open source code,
+please support me by dontating (see https://github.com/Makuna/Rtc)
+
+-------------------------------------------------------------------------
+This file is part of the Makuna/ADPS library.
+
+Rtc is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of
+the License, or (at your option) any later version.
+
+Rtc is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with Rtc.  If not, see
+<http://www.gnu.org/licenses/>.
+-------------------------------------------------------------------------*/
+
+
+#pragma once
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "AdpsPlatform.h"
+#include "WireUtil.h"
+
+namespace WIRE_UTIL
+{
+    // translates the errno of a failed i2c-dev transfer, bus drivers
+    // differ in what they report for an address NACK
+    inline uint8_t ErrnoToError(int error)
+    {
+        switch (error)
+        {
+        case 0:
+            return Error_None;
+        case ENXIO:
+        case EREMOTEIO:
+        case ENODEV:
+            return Error_NoAddressableDevice;
+        case ETIMEDOUT:
+            return Error_CommunicationTimeout;
+        case EMSGSIZE:
+        case EOVERFLOW:
+            return Error_TxBufferOverflow;
+        case EINVAL:
+        case EOPNOTSUPP:
+        case ENOSYS:
+            return Error_UnsupportedRequest;
+        default:
+            return Error_Unspecific;
+        }
+    }
+
+    // The i2c-dev ioctl layer used by LinuxI2cWire, replace it to test
+    // against a fake device.  It provides
+    //    bool Open(const char* path)
+    //    void Close()
+    //    int Transfer(i2c_msg* messages, uint8_t count) - 0 or the errno
+    //
+    class I2cDevIoctl
+    {
+    public:
+        I2cDevIoctl() :
+            _fd(-1)
+        {
+        }
+
+        ~I2cDevIoctl()
+        {
+            Close();
+        }
+
+        bool Open(const char* path)
+        {
+            Close();
+            _fd = open(path, O_RDWR);
+            return (_fd >= 0);
+        }
+
+        void Close()
+        {
+            if (_fd >= 0)
+            {
+                close(_fd);
+                _fd = -1;
+            }
+        }
+
+        int Transfer(i2c_msg* messages, uint8_t count)
+        {
+            if (_fd < 0)
+            {
+                return EBADF;
+            }
+
+            i2c_rdwr_ioctl_data transfer;
+
+            transfer.msgs = messages;
+            transfer.nmsgs = count;
+            if (ioctl(_fd, I2C_RDWR, &transfer) < 0)
+            {
+                return errno;
+            }
+            return 0;
+        }
+
+    private:
+        int _fd;
+    };
+
+    // A T_WIRE_METHOD for /dev/i2c-N on Linux.
+    //
+    // The drivers set the register pointer with a one byte write and then
+    // read, as two Wire transactions.  A one byte write is held back here
+    // and sent with the following requestFrom() as a single I2C_RDWR
+    // (write, repeated start, read), halving the syscalls and bus time.
+    // Any other call first sends the held write on its own, and if that
+    // fails the error is returned by the next endTransmission().
+    //
+    template<class T_IOCTL = I2cDevIoctl> class LinuxI2cWire
+    {
+    public:
+        LinuxI2cWire(uint8_t bus = 1)
+        {
+            snprintf(_path, sizeof(_path), "/dev/i2c-%u", bus);
+            reset();
+        }
+
+        LinuxI2cWire(const char* path)
+        {
+            snprintf(_path, sizeof(_path), "%s", path);
+            reset();
+        }
+
+        void begin()
+        {
+            reset();
+            if (!_ioctl.Open(_path))
+            {
+                _lastError = ErrnoToError(errno);
+            }
+        }
+
+        // pins are fixed by the device tree
+        void begin(int, int)
+        {
+            begin();
+        }
+
+        void end()
+        {
+            _ioctl.Close();
+        }
+
+        void beginTransmission(uint8_t address)
+        {
+            flushPending();
+            _address = address;
+            _txLength = 0;
+            _txOverflow = false;
+        }
+
+        size_t write(uint8_t value)
+        {
+            if (_txLength >= BufferLength)
+            {
+                _txOverflow = true;
+                return 0;
+            }
+            _tx[_txLength++] = value;
+            return 1;
+        }
+
+        size_t write(const uint8_t* data, size_t length)
+        {
+            size_t written = 0;
+
+            while (written < length && write(data[written]))
+            {
+                written++;
+            }
+            return written;
+        }
+
+        uint8_t endTransmission(bool sendStop = true)
+        {
+            (void)sendStop;
+
+            if (_pendingError != Error_None)
+            {
+                _lastError = _pendingError;
+                _pendingError = Error_None;
+                return _lastError;
+            }
+            if (_txOverflow)
+            {
+                _lastError = Error_TxBufferOverflow;
+                return _lastError;
+            }
+
+            if (_txLength == 1)
+            {
+                // a register pointer, hold for a combined read
+                _pending = true;
+                _lastError = Error_None;
+                return _lastError;
+            }
+
+            i2c_msg message = { _address, 0, _txLength, _tx };
+
+            _lastError = ErrnoToError(_ioctl.Transfer(&message, 1));
+            return _lastError;
+        }
+
+        uint8_t requestFrom(uint8_t address, uint8_t count, bool sendStop = true)
+        {
+            (void)sendStop;
+
+            _rxLength = 0;
+            _rxIndex = 0;
+
+            if (count > BufferLength)
+            {
+                count = BufferLength;
+            }
+
+            i2c_msg messages[2];
+            uint8_t messageCount = 0;
+
+            if (_pending && address == _address)
+            {
+                messages[messageCount++] = { _address, 0, 1, _tx };
+                _pending = false;
+            }
+            else
+            {
+                flushPending();
+                if (_pendingError != Error_None)
+                {
+                    _lastError = _pendingError;
+                    _pendingError = Error_None;
+                    return 0;
+                }
+            }
+            messages[messageCount++] = { address, I2C_M_RD, count, _rx };
+
+            _lastError = ErrnoToError(_ioctl.Transfer(messages, messageCount));
+            if (_lastError != Error_None)
+            {
+                return 0;
+            }
+            _rxLength = count;
+            return count;
+        }
+
+        int available() const
+        {
+            return _rxLength - _rxIndex;
+        }
+
+        int read()
+        {
+            if (_rxIndex >= _rxLength)
+            {
+                return -1;
+            }
+            return _rx[_rxIndex++];
+        }
+
+        int peek() const
+        {
+            if (_rxIndex >= _rxLength)
+            {
+                return -1;
+            }
+            return _rx[_rxIndex];
+        }
+
+        // the error of the last transfer, requestFrom() only returns a count
+        uint8_t LastError() const
+        {
+            return _lastError;
+        }
+
+        T_IOCTL& Ioctl()
+        {
+            return _ioctl;
+        }
+
+    private:
+        T_IOCTL _ioctl;
+        char _path[32];
+
+        uint8_t _address;
+        uint8_t _tx[BufferLength];
+        uint8_t _txLength;
+        bool _txOverflow;
+        bool _pending;
+        uint8_t _pendingError;
+
+        uint8_t _rx[BufferLength];
+        uint8_t _rxLength;
+        uint8_t _rxIndex;
+
+        uint8_t _lastError;
+
+        void reset()
+        {
+            _address = 0;
+            _txLength = 0;
+            _txOverflow = false;
+            _pending = false;
+            _pendingError = Error_None;
+            _rxLength = 0;
+            _rxIndex = 0;
+            _lastError = Error_None;
+        }
+
+        void flushPending()
+        {
+            if (_pending)
+            {
+                _pending = false;
+
+                i2c_msg message = { _address, 0, 1, _tx };
+
+                _pendingError = ErrnoToError(_ioctl.Transfer(&message, 1));
+            }
+        }
+    };
+}
+
+#endif
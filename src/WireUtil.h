@@ -26,6 +26,8 @@ License along with Rtc.  If not, see
 
 #pragma once
 
+#include "AdpsPlatform.h"
+
 namespace WIRE_UTIL
 {
     // While WIRE has return codes, there is no standard definition of what they are
@@ -42,4 +44,135 @@ namespace WIRE_UTIL
         Error_Unspecific,
         Error_CommunicationTimeout
     };
+
+    // Wire buffers are as small as 32 bytes (AVR) and that includes the
+    // register address on writes, so transfers are chunked to fit.
+    // Define WIRE_UTIL_BUFFER_LENGTH for platforms with larger buffers.
+    //
+#if !defined(WIRE_UTIL_BUFFER_LENGTH)
+#define WIRE_UTIL_BUFFER_LENGTH 32
+#endif
+
+    constexpr uint8_t BufferLength = WIRE_UTIL_BUFFER_LENGTH;
+
+    // errors that a repeat of the same transaction may not see again
+    inline bool IsTransientError(uint8_t error)
+    {
+        return (error == Error_NoAddressableDevice ||
+            error == Error_Unspecific ||
+            error == Error_CommunicationTimeout);
+    }
+
+    // estimate of the bus time of a transaction moving bytes (including
+    // the register address) plus the device address, 9 clocks a byte
+    constexpr uint32_t TransactionUs(uint8_t bytes, uint32_t clockHz = 100000)
+    {
+        return (static_cast<uint32_t>(bytes) + 1) * 9 * 1000000 / clockHz;
+    }
+
+    struct Stats
+    {
+        Stats() :
+            Transactions(0),
+            Retries(0),
+            Failures(0),
+            LastFailure(Error_None)
+        {
+        }
+
+        uint32_t Transactions;
+        uint32_t Retries;
+        uint32_t Failures; // transactions that failed every attempt
+        uint8_t LastFailure;
+    };
+
+    // Retry policies provide
+    //    static constexpr uint8_t MaxAttempts
+    //    void Backoff(uint8_t attempt) - wait before attempt + 1
+    //    static constexpr uint32_t WorstCaseUs(uint32_t transactionUs)
+    //
+    // WorstCaseUs bounds a single transaction given the bound of one attempt,
+    // which is the bus time plus the Wire timeout (setWireTimeout() on cores
+    // that support it, otherwise a hung bus can block inside Wire itself).
+    //
+    class RetryNone
+    {
+    public:
+        static constexpr uint8_t MaxAttempts = 1;
+
+        void Backoff(uint8_t)
+        {
+        }
+
+        static constexpr uint32_t WorstCaseUs(uint32_t transactionUs)
+        {
+            return transactionUs;
+        }
+    };
+
+    // retries transient errors up to V_RETRIES times, waiting V_BACKOFF_US
+    // before the first retry and doubling it for each one after
+    template<uint8_t V_RETRIES, uint16_t V_BACKOFF_US = 100> class RetryBounded
+    {
+    public:
+        static_assert(V_RETRIES < 16, "V_RETRIES must be less than 16");
+
+        static constexpr uint8_t MaxAttempts = V_RETRIES + 1;
+
+        void Backoff(uint8_t attempt)
+        {
+            delayMicroseconds(static_cast<uint32_t>(V_BACKOFF_US) << attempt);
+        }
+
+        static constexpr uint32_t WorstCaseUs(uint32_t transactionUs)
+        {
+            return transactionUs * MaxAttempts +
+                static_cast<uint32_t>(V_BACKOFF_US) * ((1UL << V_RETRIES) - 1);
+        }
+    };
+
+#if defined(ARDUINO)
+    // Frees a bus held by a slave stuck mid byte (SDA low), by clocking SCL
+    // until it releases SDA and then issuing a STOP.  Call before Wire.begin()
+    // or after Wire.end() as it takes over the pins.  Takes at most about
+    // 100us at the 100kHz timing used.
+    inline uint8_t ClearBus(uint8_t sdaPin, uint8_t sclPin)
+    {
+        constexpr uint8_t HalfClockUs = 5;
+
+        pinMode(sdaPin, INPUT_PULLUP);
+        pinMode(sclPin, INPUT_PULLUP);
+        delayMicroseconds(HalfClockUs);
+
+        if (digitalRead(sclPin) == LOW)
+        {
+            // held by clock stretching or a short, can't be cleared
+            return Error_CommunicationTimeout;
+        }
+
+        // a slave releases SDA within nine clocks of its current byte
+        for (uint8_t clock = 0; clock < 9 && digitalRead(sdaPin) == LOW; clock++)
+        {
+            pinMode(sclPin, OUTPUT);
+            digitalWrite(sclPin, LOW);
+            delayMicroseconds(HalfClockUs);
+            pinMode(sclPin, INPUT_PULLUP);
+            delayMicroseconds(HalfClockUs);
+        }
+
+        if (digitalRead(sdaPin) == LOW)
+        {
+            return Error_CommunicationTimeout;
+        }
+
+        // STOP, SDA rises while SCL is high
+        pinMode(sdaPin, OUTPUT);
+        digitalWrite(sdaPin, LOW);
+        delayMicroseconds(HalfClockUs);
+        pinMode(sdaPin, INPUT_PULLUP);
+        delayMicroseconds(HalfClockUs);
+
+        return Error_None;
+    }
+#endif
 }
\ No newline at end of file